@@ -0,0 +1,335 @@
+#include "cache.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+static const char cacheMagic[4] = {'P', 'D', 'C', 'C'};
+static const uint32_t cacheVersion = 2;
+
+// Record of the cache file, followed by the canonical ring, firstIndex,
+// indices, Steiner points, reflex vertices, firstNeighbor and neighbors,
+// padded to 8 bytes.
+struct CacheRecord {
+    uint64_t hash;
+    uint32_t vertices, pieces, indices, steiner, reflex, neighbors, merged, unused;
+};
+
+// sets merged entries apart from plain ones of the same ring
+static const uint64_t mergedSalt = 0x6d65726765640000ull;
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+static size_t payloadSize(const CacheRecord &r) {
+    return sizeof(CacheRecord) + (r.vertices + r.steiner + r.reflex) * sizeof(Point) +
+           (2 * (r.pieces + 1) + r.indices) * sizeof(uint32_t) +
+           r.neighbors * sizeof(Decomposition::Neighbor);
+}
+
+static size_t recordSize(const CacheRecord &r) {
+    return align8(payloadSize(r));
+}
+
+static uint64_t hashRing(const Polygon &ring) {
+    uint64_t h = 0xcbf29ce484222325ull ^ ring.size();
+    for (const Point &p : ring) {
+        uint64_t word;
+        memcpy(&word, &p, sizeof(word));
+        h = (h ^ word) * 0x9e3779b97f4a7c15ull;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+static bool sameRing(const Polygon &a, const Polygon &b) {
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(Point)) == 0;
+}
+
+// Rotates and orients the ring like makeCCW and moves its first vertex to
+// the origin. order[k] is the input index of canonical vertex k.
+static void canonicalize(const Point *verts, size_t n, Polygon &ring, vector<uint32_t> &order,
+                         Point &origin) {
+    double sum = 0;
+    size_t br = 0;
+    for (size_t i = 0, j = n - 1; i < n; j = i++) {
+        sum += (double(verts[j].x) - verts[i].x) * (double(verts[i].y) + verts[j].y);
+        if (verts[i].y < verts[br].y || (verts[i].y == verts[br].y && verts[i].x > verts[br].x)) {
+            br = i;
+        }
+    }
+    origin = verts[br];
+    ring.resize(n);
+    order.resize(n);
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = sum < 0 ? (br + n - k) % n : (br + k) % n;
+        order[k] = i;
+        ring[k] = Point(verts[i].x - origin.x, verts[i].y - origin.y);
+    }
+}
+
+// Appends a canonical decomposition to out, renumbered to the input vertices
+// and translated back.
+static void restore(const Decomposition &c, const Point *verts, size_t n,
+                    const vector<uint32_t> &order, const Point &origin, Decomposition &out) {
+    auto moved = [&](const Point &p) { return Point(p.x + origin.x, p.y + origin.y); };
+    uint32_t steinerBase = out.steinerPoints.size(), firstPiece = out.pieces();
+    auto id = [&](uint32_t k) { return k < n ? order[k] : k + steinerBase; };
+
+    for (const Point &p : c.steinerPoints) {
+        out.steinerPoints.push_back(moved(p));
+    }
+    for (const Point &p : c.reflexVertices) {
+        out.reflexVertices.push_back(moved(p));
+    }
+    for (const Polygon &rest : c.remainder) {
+        out.remainder.emplace_back();
+        for (const Point &p : rest) {
+            out.remainder.back().push_back(moved(p));
+        }
+    }
+    out.truncated |= c.truncated;
+    out.merged += c.merged;
+    size_t pieces = c.firstIndex.size() - 1;
+    if (out.output & Decomposition::Indices) {
+        if (out.firstIndex.empty()) {
+            out.firstIndex.push_back(0);
+        }
+        for (size_t i = 0; i < pieces; ++i) {
+            for (uint32_t k = c.firstIndex[i]; k < c.firstIndex[i + 1]; ++k) {
+                out.indices.push_back(id(c.indices[k]));
+            }
+            out.firstIndex.push_back(out.indices.size());
+        }
+    }
+    if (out.wantsPolygons()) {
+        for (size_t i = 0; i < pieces; ++i) {
+            Polygon piece;
+            for (uint32_t k = c.firstIndex[i]; k < c.firstIndex[i + 1]; ++k) {
+                uint32_t v = c.indices[k];
+                piece.push_back(v < n ? verts[order[v]] : out.steinerPoints[v - n + steinerBase]);
+            }
+            out.addPolygon(piece);
+        }
+    }
+    if (out.output & Decomposition::Adjacency) {
+        if (out.firstNeighbor.empty()) {
+            out.firstNeighbor.push_back(0);
+        }
+        out.firstNeighbor.resize(firstPiece + 1, out.neighbors.size());
+        for (size_t i = 0; i < pieces; ++i) {
+            for (uint32_t k = c.firstNeighbor[i]; k < c.firstNeighbor[i + 1]; ++k) {
+                const Decomposition::Neighbor &nb = c.neighbors[k];
+                out.neighbors.push_back({nb.piece + firstPiece, moved(nb.a), moved(nb.b)});
+            }
+            out.firstNeighbor.push_back(out.neighbors.size());
+        }
+    }
+}
+
+DecompositionCache::DecompositionCache(size_t memoryBudget, const char *path)
+    : budget(memoryBudget) {
+    if (path) {
+        this->path = path;
+        openFile();
+    }
+}
+
+DecompositionCache::~DecompositionCache() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+void DecompositionCache::openFile() {
+    // index the records of earlier runs, dropping a torn last record
+    MappedFile existing(path.c_str());
+    uint64_t end = 0;
+    if (existing.ok() && existing.size() >= 8) {
+        if (memcmp(existing.data(), cacheMagic, 4) != 0 ||
+            memcmp(existing.data() + 4, &cacheVersion, 4) != 0) {
+            err = path + ": not a decomposition cache";
+            return;
+        }
+        end = 8;
+        CacheRecord r;
+        while (end + sizeof(r) <= existing.size()) {
+            memcpy(&r, existing.data() + end, sizeof(r));
+            if (end + recordSize(r) > existing.size()) {
+                break;
+            }
+            onDisk[r.hash] = end;
+            end += recordSize(r);
+        }
+    }
+
+    file = fopen(path.c_str(), end ? "r+b" : "wb");
+    if (!file || (end && (ftruncate(fileno(file), end) != 0 || fseek(file, end, SEEK_SET) != 0))) {
+        err = path + ": " + strerror(errno);
+        onDisk.clear();
+        return;
+    }
+    if (!end) {
+        fwrite(cacheMagic, 1, 4, file);
+        fwrite(&cacheVersion, 4, 1, file);
+        end = 8;
+    }
+    fileSize = end;
+}
+
+void DecompositionCache::decompose(const Point *verts, size_t n, Decomposition &out,
+                                   const CancelToken *token) {
+    if (n < 3) {
+        return;
+    }
+    Polygon ring;
+    vector<uint32_t> order;
+    Point origin;
+    canonicalize(verts, n, ring, order, origin);
+    int merge = out.output & Decomposition::Merged;
+    uint64_t hash = hashRing(ring) ^ (merge ? mergedSalt : 0);
+
+    Decomposition result;
+    if (!find(hash, ring, result)) {
+        // computed outside the lock; a race only costs a duplicate entry
+        result.output = Decomposition::Indices | Decomposition::Adjacency | merge;
+        decomposePoly(ring, result, token);
+        if (result.firstIndex.empty()) {
+            result.firstIndex.push_back(0);
+        }
+        if (!result.truncated) {
+            lock_guard<mutex> guard(lock);
+            insert(hash, ring, result);
+            if (file && !onDisk.count(hash)) {
+                writeRecord(hash, ring, result);
+            }
+        }
+    }
+    restore(result, verts, n, order, origin, out);
+}
+
+void DecompositionCache::decompose(const Polygon &poly, Decomposition &out,
+                                   const CancelToken *token) {
+    decompose(poly.data(), poly.size(), out, token);
+}
+
+DecompositionCache::Stats DecompositionCache::stats() const {
+    lock_guard<mutex> guard(lock);
+    return counts;
+}
+
+bool DecompositionCache::find(uint64_t hash, const Polygon &ring, Decomposition &result) {
+    lock_guard<mutex> guard(lock);
+    auto it = byHash.find(hash);
+    if (it != byHash.end() && sameRing(it->second->ring, ring)) {
+        entries.splice(entries.begin(), entries, it->second);
+        result = it->second->result;
+        ++counts.hits;
+        return true;
+    }
+    auto disk = onDisk.find(hash);
+    if (disk != onDisk.end() && readRecord(disk->second, hash, ring, result)) {
+        insert(hash, ring, result);
+        ++counts.diskHits;
+        return true;
+    }
+    ++counts.misses;
+    return false;
+}
+
+// called with the lock held
+void DecompositionCache::insert(uint64_t hash, const Polygon &ring, const Decomposition &result) {
+    auto it = byHash.find(hash);
+    if (it != byHash.end()) {
+        used -= it->second->bytes;
+        entries.erase(it->second);
+    }
+    size_t bytes = sizeof(Entry) + ring.size() * sizeof(Point) +
+                   (result.indices.size() + result.firstIndex.size() +
+                    result.firstNeighbor.size()) * sizeof(uint32_t) +
+                   (result.steinerPoints.size() + result.reflexVertices.size()) * sizeof(Point) +
+                   result.neighbors.size() * sizeof(Decomposition::Neighbor);
+    entries.push_front({hash, ring, result, bytes});
+    byHash[hash] = entries.begin();
+    used += bytes;
+    while (used > budget && entries.size() > 1) {
+        used -= entries.back().bytes;
+        byHash.erase(entries.back().hash);
+        entries.pop_back();
+    }
+}
+
+template <class T> static void put(FILE *file, const vector<T> &v) {
+    fwrite(v.data(), sizeof(T), v.size(), file);
+}
+
+template <class T> static const char *get(const char *p, vector<T> &v, size_t count) {
+    v.resize(count);
+    memcpy(v.data(), p, count * sizeof(T));
+    return p + count * sizeof(T);
+}
+
+void DecompositionCache::writeRecord(uint64_t hash, const Polygon &ring,
+                                     const Decomposition &result) {
+    CacheRecord r = {hash,
+                     uint32_t(ring.size()),
+                     uint32_t(result.firstIndex.size() - 1),
+                     uint32_t(result.indices.size()),
+                     uint32_t(result.steinerPoints.size()),
+                     uint32_t(result.reflexVertices.size()),
+                     uint32_t(result.neighbors.size()),
+                     result.merged,
+                     0};
+    size_t size = recordSize(r);
+    fwrite(&r, sizeof(r), 1, file);
+    put(file, ring);
+    put(file, result.firstIndex);
+    put(file, result.indices);
+    put(file, result.steinerPoints);
+    put(file, result.reflexVertices);
+    put(file, result.firstNeighbor);
+    put(file, result.neighbors);
+    static const char padding[8] = {};
+    fwrite(padding, 1, size - payloadSize(r), file);
+    // readers map the file, so records must reach it whole
+    fflush(file);
+    if (ferror(file)) {
+        err = path + ": " + strerror(errno);
+        fclose(file);
+        file = nullptr;
+        return;
+    }
+    onDisk[hash] = fileSize;
+    fileSize += size;
+}
+
+bool DecompositionCache::readRecord(uint64_t offset, uint64_t hash, const Polygon &ring,
+                                    Decomposition &result) {
+    CacheRecord r;
+    if (!mapped || offset + sizeof(r) > mapped->size()) {
+        // records appended since the file was last mapped
+        mapped.reset(new MappedFile(path.c_str()));
+    }
+    if (!mapped->ok() || offset + sizeof(r) > mapped->size()) {
+        return false;
+    }
+    const char *p = mapped->data() + offset;
+    memcpy(&r, p, sizeof(r));
+    if (r.hash != hash || r.vertices != ring.size() || offset + recordSize(r) > mapped->size() ||
+        memcmp(p + sizeof(r), ring.data(), ring.size() * sizeof(Point)) != 0) {
+        return false;
+    }
+    p += sizeof(r) + ring.size() * sizeof(Point);
+    result.clear();
+    result.output = Decomposition::Indices | Decomposition::Adjacency;
+    p = get(p, result.firstIndex, r.pieces + 1);
+    p = get(p, result.indices, r.indices);
+    p = get(p, result.steinerPoints, r.steiner);
+    p = get(p, result.reflexVertices, r.reflex);
+    p = get(p, result.firstNeighbor, r.pieces + 1);
+    get(p, result.neighbors, r.neighbors);
+    result.merged = r.merged;
+    return true;
+}
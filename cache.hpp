@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "decomp.hpp"
+#include "mapped.hpp"
+
+// Content-addressed cache of decompositions. A ring is brought into a
+// canonical form first: counter-clockwise, starting at the bottom-right
+// vertex that makeCCW looks for, and translated so that vertex is the
+// origin. Rings equal in that form share one entry, whose pieces are
+// translated back and renumbered to the caller's vertices. Coordinates
+// are compared exactly, so only translations that are exact in float
+// (e.g. whole numbers on moderate grids) map to the same entry.
+// Merged decompositions are entries of their own.
+//
+// Recently used entries stay in memory up to a byte budget. With a file
+// path, every computed entry is also appended to that file, which is mapped
+// to serve entries evicted from memory or written by earlier runs.
+class DecompositionCache {
+public:
+    DecompositionCache(size_t memoryBudget = size_t(64) << 20, const char *path = nullptr);
+    ~DecompositionCache();
+
+    DecompositionCache(const DecompositionCache &) = delete;
+    DecompositionCache &operator=(const DecompositionCache &) = delete;
+
+    // false if the cache file could not be used; the memory tier still works
+    bool ok() const { return err.empty(); }
+    const string &error() const { return err; }
+
+    // same results and output options as decomposePoly; safe to call from
+    // several threads. Truncated results are not kept.
+    void decompose(const Point *verts, size_t n, Decomposition &out,
+                   const CancelToken *token = nullptr);
+    void decompose(const Polygon &poly, Decomposition &out, const CancelToken *token = nullptr);
+
+    struct Stats {
+        uint64_t hits = 0, diskHits = 0, misses = 0;
+        double hitRate() const {
+            uint64_t total = hits + diskHits + misses;
+            return total ? double(hits + diskHits) / total : 0;
+        }
+    };
+    Stats stats() const;
+
+private:
+    // canonical ring and its decomposition with every output
+    struct Entry {
+        uint64_t hash;
+        Polygon ring;
+        Decomposition result;
+        size_t bytes;
+    };
+    typedef list<Entry>::iterator EntryRef;
+
+    size_t budget, used = 0;
+    list<Entry> entries; // most recently used first
+    unordered_map<uint64_t, EntryRef> byHash;
+    Stats counts;
+    mutable mutex lock;
+
+    FILE *file = nullptr;
+    unique_ptr<MappedFile> mapped;
+    string path, err;
+    uint64_t fileSize = 0;
+    unordered_map<uint64_t, uint64_t> onDisk; // record offsets by hash
+
+    bool find(uint64_t hash, const Polygon &ring, Decomposition &result);
+    void insert(uint64_t hash, const Polygon &ring, const Decomposition &result);
+    bool readRecord(uint64_t offset, uint64_t hash, const Polygon &ring,
+                    Decomposition &result);
+    void writeRecord(uint64_t hash, const Polygon &ring, const Decomposition &result);
+    void openFile();
+};
@@ -0,0 +1,264 @@
+#include "client.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// connected socket or -1 with err set
+static int connectTo(const char *path, string &err) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        err = string(path) + ": socket path too long";
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (sockaddr *) &address, sizeof(address)) != 0) {
+        err = string(path) + ": " + strerror(errno);
+    }
+    return fd;
+}
+
+DecompositionClient::DecompositionClient(const char *path) {
+    fd = connectTo(path, err);
+}
+
+DecompositionClient::~DecompositionClient() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool DecompositionClient::fail(const char *what) {
+    if (err.empty()) {
+        err = what;
+    }
+    return false;
+}
+
+bool DecompositionClient::writeAll(const char *data, size_t size) {
+    while (size) {
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return fail(strerror(errno));
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool DecompositionClient::readAll(char *data, size_t size) {
+    while (size) {
+        ssize_t n = recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return fail(n == 0 ? "server closed the connection" : strerror(errno));
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool DecompositionClient::send(uint32_t id, const Rings &rings) {
+    if (!ok()) {
+        return false;
+    }
+    uint32_t size = jobSize(rings);
+    buffer.resize(sizeof(size) + size);
+    memcpy(buffer.data(), &size, sizeof(size));
+    encodeJob(id, rings, buffer.data() + sizeof(size));
+    return writeAll(buffer.data(), buffer.size());
+}
+
+bool DecompositionClient::receive(uint32_t &id, Decomposition &result) {
+    uint32_t size;
+    if (!ok() || !readAll((char *) &size, sizeof(size))) {
+        return false;
+    }
+    buffer.resize(size);
+    if (!readAll(buffer.data(), size)) {
+        return false;
+    }
+    JobStatus status;
+    if (!decodeResult(buffer.data(), size, id, status, result)) {
+        return fail("malformed result");
+    }
+    if (status != jobDone) {
+        return fail("server rejected the job");
+    }
+    return true;
+}
+
+bool DecompositionClient::decompose(const Rings &rings, Decomposition &result) {
+    uint32_t id = nextId++, answered;
+    if (!send(id, rings) || !receive(answered, result)) {
+        return false;
+    }
+    return answered == id || fail("result out of order");
+}
+
+SharedMemoryClient::SharedMemoryClient(const char *path, size_t ringSize) {
+    ringSize = (ringSize + 4095) & ~size_t(4095);
+    regionSize = SharedRegion::size(ringSize);
+    fd = connectTo(path, err);
+    int memory = createSharedMemory("polydecomp", regionSize);
+    serverWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    clientWake = eventfd(0, EFD_CLOEXEC);
+    if (!ok()) {
+        if (memory >= 0) {
+            close(memory);
+        }
+        return;
+    }
+    void *base = memory < 0 ? MAP_FAILED
+                            : mmap(nullptr, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                   memory, 0);
+    if (base == MAP_FAILED || serverWake < 0 || clientWake < 0) {
+        fail(strerror(errno));
+        if (memory >= 0) {
+            close(memory);
+        }
+        return;
+    }
+    region = new (base) SharedRegion();
+    region->tag = SharedRegion::magic;
+    region->version = 1;
+    region->ringSize = ringSize;
+    jobs = SharedRing(&region->jobs, region->jobData(), ringSize);
+    results = SharedRing(&region->results, region->resultData(), ringSize);
+
+    // an empty frame carrying the memory and both eventfds switches the
+    // connection over to the rings
+    uint32_t empty = 0;
+    iovec data = {&empty, sizeof(empty)};
+    int fds[3] = {memory, serverWake, clientWake};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+    msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+    if (sendmsg(fd, &message, MSG_NOSIGNAL) != sizeof(empty)) {
+        fail(strerror(errno));
+    }
+    close(memory);
+}
+
+SharedMemoryClient::~SharedMemoryClient() {
+    if (region) {
+        munmap(region, regionSize);
+    }
+    for (int f : {fd, serverWake, clientWake}) {
+        if (f >= 0) {
+            close(f);
+        }
+    }
+}
+
+bool SharedMemoryClient::fail(const char *what) {
+    if (err.empty()) {
+        err = what;
+    }
+    return false;
+}
+
+// sleeps until the server signals, false once it has gone away
+bool SharedMemoryClient::wait() {
+    pollfd fds[2] = {{clientWake, POLLIN, 0}, {fd, POLLIN, 0}};
+    while (poll(fds, 2, -1) < 0) {
+        if (errno != EINTR) {
+            return fail(strerror(errno));
+        }
+    }
+    if (fds[1].revents) {
+        return fail("server closed the connection");
+    }
+    waitEvent(clientWake);
+    return true;
+}
+
+bool SharedMemoryClient::send(uint32_t id, const Rings &rings) {
+    if (!ok()) {
+        return false;
+    }
+    uint32_t size = jobSize(rings);
+    if (size > jobs.maxRecord()) {
+        return fail("job larger than the shared ring");
+    }
+    char *record;
+    while (!(record = jobs.reserve(size))) {
+        if (!wait()) {
+            return false;
+        }
+    }
+    encodeJob(id, rings, record);
+    if (jobs.commit()) {
+        signalEvent(serverWake);
+    }
+    return true;
+}
+
+bool SharedMemoryClient::receive(ResultView &result) {
+    if (!ok()) {
+        return false;
+    }
+    const char *record;
+    uint32_t size;
+    while (!(record = results.peek(size))) {
+        if (!wait()) {
+            return false;
+        }
+    }
+    if (!viewResult(record, size, result)) {
+        return fail("malformed result");
+    }
+    if (result.status != jobDone) {
+        return fail(result.status == jobTooLarge ? "result larger than the shared ring"
+                                                 : "server rejected the job");
+    }
+    return true;
+}
+
+void SharedMemoryClient::release() {
+    if (results.pop()) {
+        signalEvent(serverWake);
+    }
+}
+
+bool SharedMemoryClient::receive(uint32_t &id, Decomposition &result) {
+    ResultView view;
+    if (!receive(view)) {
+        return false;
+    }
+    id = view.id;
+    copyResult(view, result);
+    release();
+    return true;
+}
+
+bool SharedMemoryClient::decompose(const Rings &rings, Decomposition &result) {
+    uint32_t id = nextId++, answered;
+    if (!send(id, rings) || !receive(answered, result)) {
+        return false;
+    }
+    return answered == id || fail("result out of order");
+}
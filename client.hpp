@@ -0,0 +1,74 @@
+#pragma once
+
+#include "protocol.hpp"
+#include "shm.hpp"
+
+// Connection to a polydecomp_server over its Unix domain socket. Jobs may be
+// pipelined: results come back in the order their jobs were sent. Frames
+// are a 32-bit byte count followed by a job or result (see protocol.hpp).
+class DecompositionClient {
+public:
+    DecompositionClient(const char *path);
+    ~DecompositionClient();
+
+    DecompositionClient(const DecompositionClient &) = delete;
+    DecompositionClient &operator=(const DecompositionClient &) = delete;
+
+    bool ok() const { return err.empty(); }
+    const string &error() const { return err; }
+
+    bool send(uint32_t id, const Rings &rings);
+    // blocks for the next result, its pieces are indexed
+    bool receive(uint32_t &id, Decomposition &result);
+    // one round trip
+    bool decompose(const Rings &rings, Decomposition &result);
+
+private:
+    int fd = -1;
+    uint32_t nextId = 0;
+    vector<char> buffer;
+    string err;
+
+    bool fail(const char *what);
+    bool writeAll(const char *data, size_t size);
+    bool readAll(char *data, size_t size);
+};
+
+// Connection to a polydecomp_server through shared memory: the client hands
+// the server a memfd holding a ring of jobs and a ring of results, so jobs
+// are encoded and results read in place without going through the socket,
+// which is left to carry only the handshake. Notifications are eventfds,
+// signalled only when the other side sleeps.
+class SharedMemoryClient {
+public:
+    SharedMemoryClient(const char *path, size_t ringSize = size_t(16) << 20);
+    ~SharedMemoryClient();
+
+    SharedMemoryClient(const SharedMemoryClient &) = delete;
+    SharedMemoryClient &operator=(const SharedMemoryClient &) = delete;
+
+    bool ok() const { return err.empty(); }
+    const string &error() const { return err; }
+
+    // encodes the job into the job ring, waiting for room
+    bool send(uint32_t id, const Rings &rings);
+    // Blocks for the next result and views it in the result ring; the view
+    // stays valid until release().
+    bool receive(ResultView &result);
+    void release();
+    // copies the next result out of the ring
+    bool receive(uint32_t &id, Decomposition &result);
+    // one round trip
+    bool decompose(const Rings &rings, Decomposition &result);
+
+private:
+    int fd = -1, serverWake = -1, clientWake = -1;
+    SharedRegion *region = nullptr;
+    size_t regionSize = 0;
+    SharedRing jobs, results;
+    uint32_t nextId = 0;
+    string err;
+
+    bool fail(const char *what);
+    bool wait();
+};
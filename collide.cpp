@@ -0,0 +1,277 @@
+#include "collide.hpp"
+
+#include <algorithm>
+#include <limits>
+
+static Scalar dot(const Point &a, const Point &b) {
+    return a.x * b.x + a.y * b.y;
+}
+
+static Point sub(const Point &a, const Point &b) {
+    return Point(a.x - b.x, a.y - b.y);
+}
+
+void ConvexPieces::build(const vector<Polygon> &polys) {
+    pieces = &polys;
+    normals.clear();
+    first.clear();
+    boxes.clear();
+    for (const Polygon &piece : polys) {
+        first.push_back(normals.size());
+        Box box = {numeric_limits<Scalar>::max(), numeric_limits<Scalar>::max(),
+                   -numeric_limits<Scalar>::max(), -numeric_limits<Scalar>::max()};
+        for (size_t i = 0; i < piece.size(); ++i) {
+            const Point &a = piece[i], &b = piece[(i + 1) % piece.size()];
+            Scalar dx = b.x - a.x, dy = b.y - a.y, length = sqrt(dx * dx + dy * dy);
+            normals.push_back(length > 0 ? Point(dy / length, -dx / length) : Point());
+            box.minX = std::min(box.minX, a.x);
+            box.minY = std::min(box.minY, a.y);
+            box.maxX = max(box.maxX, a.x);
+            box.maxY = max(box.maxY, a.y);
+        }
+        boxes.push_back(box);
+    }
+}
+
+// whether an edge normal of a separates b from it; a's extent along its own
+// edge normal ends at that edge
+static bool separates(const ConvexView &a, const ConvexView &b) {
+    for (uint32_t i = 0; i < a.count; ++i) {
+        Scalar limit = dot(a.normals[i], a.verts[i]);
+        uint32_t j = 0;
+        while (j < b.count && dot(a.normals[i], b.verts[j]) > limit) {
+            ++j;
+        }
+        if (j == b.count) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool overlap(const ConvexView &a, const ConvexView &b) {
+    return !separates(a, b) && !separates(b, a);
+}
+
+namespace {
+
+// Vertex of the Minkowski difference a - b with the vertices it came from.
+struct SupportPoint {
+    Point p, a, b;
+};
+
+SupportPoint support(const ConvexView &a, const ConvexView &b, const Point &d) {
+    uint32_t ia = 0, ib = 0;
+    Scalar best = dot(a.verts[0], d);
+    for (uint32_t i = 1; i < a.count; ++i) {
+        Scalar s = dot(a.verts[i], d);
+        if (s > best) {
+            best = s;
+            ia = i;
+        }
+    }
+    best = -dot(b.verts[0], d);
+    for (uint32_t i = 1; i < b.count; ++i) {
+        Scalar s = -dot(b.verts[i], d);
+        if (s > best) {
+            best = s;
+            ib = i;
+        }
+    }
+    return {sub(a.verts[ia], b.verts[ib]), a.verts[ia], b.verts[ib]};
+}
+
+} // namespace
+
+Scalar distance(const ConvexView &a, const ConvexView &b, Point *onA, Point *onB) {
+    // simplex of up to three support points and the barycentric weights of
+    // the point closest to the origin
+    SupportPoint s[3];
+    Scalar w[3] = {1, 0, 0};
+    int size = 1;
+    s[0] = {sub(a.verts[0], b.verts[0]), a.verts[0], b.verts[0]};
+    Point v = s[0].p;
+
+    for (int iteration = 0; iteration < 64; ++iteration) {
+        Scalar vv = dot(v, v);
+        if (vv == 0) {
+            break;
+        }
+        SupportPoint next = support(a, b, Point(-v.x, -v.y));
+        // no support point gets closer to the origin than v
+        if (vv - dot(v, next.p) <= 1e-6f * vv) {
+            break;
+        }
+        // rounding can make the simplex cycle; keep the best one seen
+        SupportPoint keepS[3] = {s[0], s[1], s[2]};
+        Scalar keepW[3] = {w[0], w[1], w[2]};
+        int keepSize = size;
+        s[size++] = next;
+
+        if (size == 2) {
+            // closest point on the segment s0-s1
+            Point e = sub(s[1].p, s[0].p);
+            Scalar t = -dot(s[0].p, e) / dot(e, e);
+            if (t <= 0) {
+                size = 1;
+                w[0] = 1;
+            } else if (t >= 1) {
+                s[0] = s[1];
+                size = 1;
+                w[0] = 1;
+            } else {
+                w[0] = 1 - t;
+                w[1] = t;
+            }
+        } else {
+            // triangle: the origin is inside, or closest to one of its edges
+            Scalar total = area(s[0].p, s[1].p, s[2].p);
+            Scalar u = area(Point(), s[1].p, s[2].p), t = area(s[0].p, Point(), s[2].p);
+            Scalar r = total - u - t;
+            if (total != 0 && (total > 0 ? u >= 0 && t >= 0 && r >= 0
+                                         : u <= 0 && t <= 0 && r <= 0)) {
+                v = Point();
+                w[0] = u / total;
+                w[1] = t / total;
+                w[2] = r / total;
+                break;
+            }
+            static const int edges[3][2] = {{0, 1}, {0, 2}, {1, 2}};
+            Scalar best = numeric_limits<Scalar>::max(), bestT = 0;
+            int keep = 0;
+            for (int k = 0; k < 3; ++k) {
+                const Point &p = s[edges[k][0]].p;
+                Point e = sub(s[edges[k][1]].p, p);
+                Scalar len = dot(e, e);
+                Scalar t = len > 0 ? std::min(max(-dot(p, e) / len, Scalar(0)), Scalar(1)) : 0;
+                Point q(p.x + e.x * t, p.y + e.y * t);
+                if (dot(q, q) < best) {
+                    best = dot(q, q);
+                    bestT = t;
+                    keep = k;
+                }
+            }
+            SupportPoint first = s[edges[keep][0]], second = s[edges[keep][1]];
+            s[0] = first;
+            s[1] = second;
+            size = 2;
+            w[0] = 1 - bestT;
+            w[1] = bestT;
+        }
+
+        Point closer;
+        for (int i = 0; i < size; ++i) {
+            closer.x += w[i] * s[i].p.x;
+            closer.y += w[i] * s[i].p.y;
+        }
+        if (dot(closer, closer) >= vv) {
+            copy(keepS, keepS + 3, s);
+            copy(keepW, keepW + 3, w);
+            size = keepSize;
+            break;
+        }
+        v = closer;
+    }
+
+    if (onA || onB) {
+        Point pa, pb;
+        for (int i = 0; i < size; ++i) {
+            pa.x += w[i] * s[i].a.x;
+            pa.y += w[i] * s[i].a.y;
+            pb.x += w[i] * s[i].b.x;
+            pb.y += w[i] * s[i].b.y;
+        }
+        if (onA) {
+            *onA = pa;
+        }
+        if (onB) {
+            *onB = pb;
+        }
+    }
+    return sqrt(dot(v, v));
+}
+
+void sweepAndPrune(const vector<Box> &boxes, vector<pair<uint32_t, uint32_t>> &pairs) {
+    vector<uint32_t> order(boxes.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(),
+         [&](uint32_t l, uint32_t r) { return boxes[l].minX < boxes[r].minX; });
+
+    // boxes whose x extent still reaches the sweep position
+    vector<uint32_t> active;
+    for (uint32_t i : order) {
+        const Box &box = boxes[i];
+        size_t kept = 0;
+        for (uint32_t j : active) {
+            if (boxes[j].maxX < box.minX) {
+                continue;
+            }
+            active[kept++] = j;
+            if (boxes[j].minY <= box.maxY && box.minY <= boxes[j].maxY) {
+                pairs.emplace_back(std::min(i, j), max(i, j));
+            }
+        }
+        active.resize(kept);
+        active.push_back(i);
+    }
+}
+
+void collide(const ConvexPieces &pieces, vector<pair<uint32_t, uint32_t>> &contacts) {
+    vector<pair<uint32_t, uint32_t>> candidates;
+    sweepAndPrune(pieces.bounds(), candidates);
+    for (const auto &c : candidates) {
+        if (overlap(pieces[c.first], pieces[c.second])) {
+            contacts.push_back(c);
+        }
+    }
+}
+
+void sweepAndPrune(const vector<Box> &a, const vector<Box> &b,
+                   vector<pair<uint32_t, uint32_t>> &pairs) {
+    // both sets in one order on x, b's boxes numbered after a's
+    vector<uint32_t> order(a.size() + b.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    auto box = [&](uint32_t i) -> const Box & { return i < a.size() ? a[i] : b[i - a.size()]; };
+    sort(order.begin(), order.end(),
+         [&](uint32_t l, uint32_t r) { return box(l).minX < box(r).minX; });
+
+    // each box is only tested against the active boxes of the other set
+    vector<uint32_t> active[2];
+    for (uint32_t i : order) {
+        const Box &current = box(i);
+        int side = i >= a.size();
+        vector<uint32_t> &other = active[1 - side];
+        size_t kept = 0;
+        for (uint32_t j : other) {
+            const Box &candidate = box(j);
+            if (candidate.maxX < current.minX) {
+                continue;
+            }
+            other[kept++] = j;
+            if (candidate.minY <= current.maxY && current.minY <= candidate.maxY) {
+                if (side) {
+                    pairs.emplace_back(j, i - a.size());
+                } else {
+                    pairs.emplace_back(i, j - a.size());
+                }
+            }
+        }
+        other.resize(kept);
+        active[side].push_back(i);
+    }
+}
+
+void collide(const ConvexPieces &a, const ConvexPieces &b,
+             vector<pair<uint32_t, uint32_t>> &contacts) {
+    vector<pair<uint32_t, uint32_t>> candidates;
+    sweepAndPrune(a.bounds(), b.bounds(), candidates);
+    for (const auto &c : candidates) {
+        if (overlap(a[c.first], b[c.second])) {
+            contacts.push_back(c);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+#include "point.hpp"
+
+// Axis-aligned bounding box.
+struct Box {
+    Scalar minX, minY, maxX, maxY;
+
+    bool overlaps(const Box &o) const {
+        return minX <= o.maxX && o.minX <= maxX && minY <= o.maxY && o.minY <= maxY;
+    }
+};
+
+// One convex piece as the collision kernel sees it: counter-clockwise
+// vertices and the outward unit normal of every edge, edge i running from
+// vertex i to vertex i + 1.
+struct ConvexView {
+    const Point *verts;
+    const Point *normals;
+    uint32_t count;
+};
+
+// Edge normals and bounds for the convex pieces of a decomposition. The
+// vertices are read in place from the pieces, which have to outlive this.
+class ConvexPieces {
+public:
+    ConvexPieces() {}
+    explicit ConvexPieces(const vector<Polygon> &pieces) { build(pieces); }
+
+    void build(const vector<Polygon> &pieces);
+
+    size_t size() const { return pieces ? pieces->size() : 0; }
+    ConvexView operator[](size_t i) const {
+        return {(*pieces)[i].data(), normals.data() + first[i], uint32_t((*pieces)[i].size())};
+    }
+    const vector<Box> &bounds() const { return boxes; }
+
+private:
+    const vector<Polygon> *pieces = nullptr;
+    vector<Point> normals;
+    vector<uint32_t> first;
+    vector<Box> boxes;
+};
+
+// Separating axis test: false if one of the edge normals separates the
+// pieces. Touching pieces overlap.
+bool overlap(const ConvexView &a, const ConvexView &b);
+
+// Distance between two pieces by GJK, 0 if they overlap. The closest points
+// on a and b are stored when requested.
+Scalar distance(const ConvexView &a, const ConvexView &b, Point *onA = nullptr,
+                Point *onB = nullptr);
+
+// Sweep and prune: every pair (i, j), i < j, of overlapping boxes, found by
+// sorting the boxes on x and sweeping over them.
+void sweepAndPrune(const vector<Box> &boxes, vector<pair<uint32_t, uint32_t>> &pairs);
+// Every pair (i, j) of overlapping boxes a[i] and b[j]; boxes are only
+// tested against those of the other set.
+void sweepAndPrune(const vector<Box> &a, const vector<Box> &b,
+                   vector<pair<uint32_t, uint32_t>> &pairs);
+
+// Overlapping pieces of one set, or between two sets (first index into a,
+// second into b).
+void collide(const ConvexPieces &pieces, vector<pair<uint32_t, uint32_t>> &contacts);
+void collide(const ConvexPieces &a, const ConvexPieces &b,
+             vector<pair<uint32_t, uint32_t>> &contacts);
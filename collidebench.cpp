@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#include "collide.hpp"
+#include "decomp.hpp"
+
+// Decomposes two overlapping generated rings and measures collision of their
+// pieces. The results are checked as well: contacts against testing every
+// pair, GJK distances against the closest pair of vertex and edge, and a few
+// pieces whose overlap and distance are known. Exits with 1 on a mismatch.
+
+static Polygon makeRing(size_t n, double cx, mt19937 &rng) {
+    uniform_real_distribution<Scalar> jitter(0.8f, 1.0f);
+    Polygon poly;
+    for (size_t i = 0; i < n; ++i) {
+        double a = 2 * PI * i / n;
+        double r = 1000 * jitter(rng) * (1 + 0.3 * sin(a * 17));
+        poly.push_back(Point(cx + r * cos(a), r * sin(a)));
+    }
+    return poly;
+}
+
+static double seconds(chrono::steady_clock::time_point since) {
+    return chrono::duration<double>(chrono::steady_clock::now() - since).count();
+}
+
+static Scalar segmentDistance(const Point &p, const Point &a, const Point &b) {
+    double dx = b.x - a.x, dy = b.y - a.y, len = dx * dx + dy * dy;
+    double t = len > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / len : 0;
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+    return hypot(p.x - (a.x + t * dx), p.y - (a.y + t * dy));
+}
+
+// distance between separated convex pieces: some vertex of one is closest
+// to an edge of the other
+static Scalar bruteDistance(const ConvexView &a, const ConvexView &b) {
+    Scalar best = numeric_limits<Scalar>::max();
+    for (int pass = 0; pass < 2; ++pass) {
+        const ConvexView &p = pass ? b : a, &q = pass ? a : b;
+        for (uint32_t i = 0; i < p.count; ++i) {
+            for (uint32_t j = 0; j < q.count; ++j) {
+                const Point &from = q.verts[j], &to = q.verts[(j + 1) % q.count];
+                best = std::min(best, segmentDistance(p.verts[i], from, to));
+            }
+        }
+    }
+    return best;
+}
+
+// pieces with a known answer
+static int checkKnown() {
+    Polygon square = {Point(0, 0), Point(1, 0), Point(1, 1), Point(0, 1)};
+    auto moved = [&](Scalar dx, Scalar dy) {
+        Polygon p = square;
+        for (Point &q : p) {
+            q = Point(q.x + dx, q.y + dy);
+        }
+        return p;
+    };
+    struct Case {
+        Polygon a, b;
+        bool overlaps;
+        Scalar distance;
+    };
+    vector<Case> cases = {
+        {square, moved(0.5f, 0.5f), true, 0},
+        {square, moved(1, 0), true, 0},
+        {square, moved(3, 0), false, 2},
+        {square, moved(2, 2), false, Scalar(sqrt(2.0))},
+        {square, {Point(3, -1), Point(4, 0.5f), Point(3, 2)}, false, 2},
+        {square, {Point(0.2f, 0.2f), Point(0.8f, 0.2f), Point(0.5f, 0.8f)}, true, 0},
+    };
+    int failed = 0;
+    for (const Case &c : cases) {
+        vector<Polygon> pieces = {c.a, c.b};
+        ConvexPieces view(pieces);
+        bool overlaps = overlap(view[0], view[1]);
+        Scalar d = distance(view[0], view[1]);
+        if (overlaps != c.overlaps || fabs(d - c.distance) > 1e-5f) {
+            fprintf(stderr, "known case: overlap %d distance %g, expected %d %g\n", overlaps, d,
+                    c.overlaps, c.distance);
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    size_t vertices = 2000, samples = 20000;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            vertices = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            samples = atol(argv[++i]);
+        }
+    }
+
+    mt19937 rng(1);
+    Decomposition first, second;
+    decomposePoly(makeRing(vertices, 0, rng), first);
+    decomposePoly(makeRing(vertices, 700, rng), second);
+    ConvexPieces a(first.polys), b(second.polys);
+    printf("%zu and %zu pieces\n", a.size(), b.size());
+
+    vector<pair<uint32_t, uint32_t>> contacts;
+    auto start = chrono::steady_clock::now();
+    collide(a, contacts);
+    printf("within one set: %zu contacts in %.2f ms\n", contacts.size(), seconds(start) * 1e3);
+
+    contacts.clear();
+    start = chrono::steady_clock::now();
+    collide(a, b, contacts);
+    printf("between sets:   %zu contacts in %.2f ms\n", contacts.size(), seconds(start) * 1e3);
+
+    int failed = checkKnown();
+
+    // every pair of pieces
+    vector<pair<uint32_t, uint32_t>> expected;
+    for (uint32_t i = 0; i < a.size(); ++i) {
+        for (uint32_t j = 0; j < b.size(); ++j) {
+            if (overlap(a[i], b[j])) {
+                expected.emplace_back(i, j);
+            }
+        }
+    }
+    sort(contacts.begin(), contacts.end());
+    if (contacts != expected) {
+        fprintf(stderr, "contacts: %zu, testing every pair: %zu\n", contacts.size(),
+                expected.size());
+        ++failed;
+    }
+
+    // GJK against the brute force distance, to a thousandth of the ring radius
+    const Scalar tolerance = 1;
+    uniform_int_distribution<uint32_t> pickA(0, a.size() - 1), pickB(0, b.size() - 1);
+    vector<pair<uint32_t, uint32_t>> picked(samples);
+    for (auto &pick : picked) {
+        pick = {pickA(rng), pickB(rng)};
+    }
+    vector<Scalar> found(samples);
+    start = chrono::steady_clock::now();
+    for (size_t k = 0; k < samples; ++k) {
+        found[k] = distance(a[picked[k].first], b[picked[k].second]);
+    }
+    printf("%zu distances in %.2f ms\n", samples, seconds(start) * 1e3);
+    size_t wrong = 0;
+    for (size_t k = 0; k < samples; ++k) {
+        ConvexView p = a[picked[k].first], q = b[picked[k].second];
+        Scalar brute = overlap(p, q) ? 0 : bruteDistance(p, q);
+        wrong += fabs(found[k] - brute) > tolerance;
+    }
+    if (wrong) {
+        fprintf(stderr, "%zu distances off by more than %g\n", wrong, tolerance);
+        ++failed;
+    }
+    return failed ? 1 : 0;
+}
@@ -19,4 +19,4 @@ Scalar min(const Scalar &a, const Scalar &b);
 int wrap(const int &a, const int &b);
 Scalar srand(const Scalar &min, const Scalar &max);
 
-template <class T> T &at(vector<T> v, int i) { return v[wrap(i, v.size())]; };
+template <class T> const T &at(const vector<T> &v, int i) { return v[wrap(i, v.size())]; };
@@ -0,0 +1,149 @@
+#include "cut.hpp"
+
+#include <algorithm>
+#include <limits>
+
+// points kept per side before they go to the writer
+static const size_t bufferSize = 4096;
+
+RingCutter::RingCutter(int axis, double at, Writer write)
+    : axis(axis), at(at), write(move(write)) {
+}
+
+void RingCutter::put(int side, const Point &p) {
+    buffer[side].push_back(p);
+    ++written[side];
+    if (buffer[side].size() == bufferSize) {
+        flush(side);
+    }
+}
+
+void RingCutter::flush(int side) {
+    if (!buffer[side].empty()) {
+        write(side, buffer[side].data(), buffer[side].size());
+        buffer[side].clear();
+    }
+}
+
+// ends the current chain at the point where a-b crosses the line and starts
+// one on the other side there
+void RingCutter::cross(const Point &a, const Point &b) {
+    double ta = axis ? a.y : a.x, tb = axis ? b.y : b.x;
+    double ua = axis ? a.x : a.y, ub = axis ? b.x : b.y;
+    double t = ua + (at - ta) * (ub - ua) / (tb - ta);
+    Point p = axis ? Point(t, at) : Point(at, t);
+
+    uint32_t index = crossings.size();
+    put(side, p);
+    Chain &done = chains.back();
+    done.ranges[0].count = written[side] - done.ranges[0].first;
+    done.to = index;
+
+    side = 1 - side;
+    crossings.push_back({t, uint32_t(chains.size())});
+    chains.push_back({side, {{written[side], 0}, {0, 0}}, int32_t(index), -1});
+    put(side, p);
+}
+
+void RingCutter::add(const Point *points, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const Point &p = points[i];
+        if (side < 0) {
+            first = p;
+            side = sideOf(p);
+            chains.push_back({side, {{0, 0}, {0, 0}}, -1, -1});
+        } else if (sideOf(p) != side) {
+            cross(last, p);
+        }
+        put(side, p);
+        last = p;
+    }
+}
+
+void RingCutter::finish(vector<vector<PointRange>> rings[2]) {
+    rings[0].clear();
+    rings[1].clear();
+    if (side < 0) {
+        return;
+    }
+    if (sideOf(first) != side) {
+        cross(last, first);
+    }
+    flush(0);
+    flush(1);
+    Chain &tail = chains.back();
+    tail.ranges[0].count = written[side] - tail.ranges[0].first;
+    if (chains.size() == 1) {
+        rings[side].push_back({tail.ranges[0]});
+        return;
+    }
+
+    // the chain running into the start continues with the first one
+    Chain &head = chains[0];
+    head.ranges[1] = head.ranges[0];
+    head.ranges[0] = tail.ranges[0];
+    head.from = tail.from;
+    crossings[head.from].chainOut = 0;
+    chains.pop_back();
+
+    // along the line, crossings alternate between leaving and entering the
+    // polygon, so consecutive ones bound a stretch of cut inside it
+    vector<uint32_t> order(crossings.size()), partner(crossings.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(),
+         [&](uint32_t l, uint32_t r) { return crossings[l].t < crossings[r].t; });
+    for (size_t i = 0; i + 1 < order.size(); i += 2) {
+        partner[order[i]] = order[i + 1];
+        partner[order[i + 1]] = order[i];
+    }
+
+    // each ring follows a chain to the line, along the cut to the partner
+    // crossing, and on with the chain leaving from there
+    vector<bool> used(chains.size());
+    for (size_t start = 0; start < chains.size(); ++start) {
+        if (used[start]) {
+            continue;
+        }
+        vector<PointRange> ring;
+        size_t c = start;
+        do {
+            used[c] = true;
+            for (const PointRange &range : chains[c].ranges) {
+                if (range.count) {
+                    ring.push_back(range);
+                }
+            }
+            c = crossings[partner[chains[c].to]].chainOut;
+        } while (c != start && !used[c]);
+        rings[chains[start].side].push_back(ring);
+    }
+}
+
+double cutPosition(Scalar lo, Scalar hi) {
+    Scalar mid = Scalar((double(lo) + hi) / 2);
+    Scalar next = nextafter(mid, numeric_limits<Scalar>::max());
+    return (double(mid) + next) / 2;
+}
+
+void cutRing(const Point *poly, size_t n, int axis, double at, vector<Polygon> &below,
+             vector<Polygon> &above) {
+    vector<Point> streams[2];
+    RingCutter cutter(axis, at, [&](int side, const Point *points, size_t count) {
+        streams[side].insert(streams[side].end(), points, points + count);
+    });
+    cutter.add(poly, n);
+    vector<vector<PointRange>> rings[2];
+    cutter.finish(rings);
+    vector<Polygon> *out[2] = {&below, &above};
+    for (int side = 0; side < 2; ++side) {
+        for (const vector<PointRange> &ring : rings[side]) {
+            out[side]->emplace_back();
+            for (const PointRange &range : ring) {
+                const Point *p = streams[side].data() + range.first;
+                out[side]->back().insert(out[side]->back().end(), p, p + range.count);
+            }
+        }
+    }
+}
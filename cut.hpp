@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "point.hpp"
+
+// A stretch of points in one side's stream of a RingCutter.
+struct PointRange {
+    uint64_t first, count;
+};
+
+// Splits a simple ring along an axis-aligned line into the simple rings on
+// either side, joined along the cut. The ring is fed in order and in any
+// number of parts, and its points leave as two sequential streams, one per
+// side, so neither the input nor the output has to be in memory: only the
+// crossings with the line are kept. Every output ring is a list of ranges
+// of its side's stream.
+//
+// The line should not pass through any vertex, which cutPosition ensures.
+// Points on the cut get the coordinate rounded to Scalar, shared by the
+// rings on both sides.
+class RingCutter {
+public:
+    // side 0 lies below the line, side 1 above it
+    typedef function<void(int side, const Point *points, size_t count)> Writer;
+
+    // axis 0 cuts at x = at, axis 1 at y = at
+    RingCutter(int axis, double at, Writer write);
+
+    void add(const Point *points, size_t count);
+    // closes the ring and lists the rings of each side
+    void finish(vector<vector<PointRange>> rings[2]);
+
+private:
+    struct Chain {
+        int side;
+        PointRange ranges[2]; // the chain wrapping past the start has two
+        int32_t from, to;     // crossings at either end, -1 for the start
+    };
+    struct Crossing {
+        double t; // position along the line
+        uint32_t chainOut;
+    };
+
+    int axis;
+    double at;
+    Writer write;
+    vector<Point> buffer[2];
+    uint64_t written[2] = {0, 0};
+    vector<Chain> chains;
+    vector<Crossing> crossings;
+    Point first, last;
+    int side = -1;
+
+    int sideOf(const Point &p) const { return (axis ? p.y : p.x) < at ? 0 : 1; }
+    void put(int side, const Point &p);
+    void flush(int side);
+    void cross(const Point &a, const Point &b);
+};
+
+// A cut line between lo and hi that cannot pass through a Scalar coordinate:
+// halfway between two neighboring floats near the middle.
+double cutPosition(Scalar lo, Scalar hi);
+
+// In-memory RingCutter: the rings of poly on either side of the line.
+void cutRing(const Point *poly, size_t n, int axis, double at, vector<Polygon> &below,
+             vector<Polygon> &above);
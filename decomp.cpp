@@ -0,0 +1,495 @@
+#include "decomp.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+
+#include "merge.hpp"
+#include "simplify.hpp"
+#include "triangulate.hpp"
+
+typedef vector<uint32_t> Ring;
+
+size_t Decomposition::pieces() const {
+    return (output & Polygons) || firstIndex.empty() ? polys.size() : firstIndex.size() - 1;
+}
+
+void Decomposition::clear() {
+    polys.clear();
+    indices.clear();
+    firstIndex.clear();
+    neighbors.clear();
+    firstNeighbor.clear();
+    steinerPoints.clear();
+    reflexVertices.clear();
+    remainder.clear();
+    truncated = false;
+    merged = 0;
+}
+
+void Decomposition::addPolygon(Polygon &piece) {
+    if (sink) {
+        sink(piece);
+    }
+    if (output & Polygons) {
+        polys.emplace_back();
+        polys.back().swap(piece);
+    }
+}
+
+void makeCCW(Polygon &poly) {
+    int br = 0;
+
+    // find bottom right point
+    for (int i = 1; i < poly.size(); ++i) {
+        if (poly[i].y < poly[br].y ||
+            (poly[i].y == poly[br].y && poly[i].x > poly[br].x)) {
+            br = i;
+        }
+    }
+
+    // reverse poly if clockwise
+    if (!left(at(poly, br - 1), at(poly, br), at(poly, br + 1))) {
+        reverse(poly.begin(), poly.end());
+    }
+}
+
+bool isReflex(const Polygon &poly, const int &i) {
+    return right(at(poly, i - 1), at(poly, i), at(poly, i + 1));
+}
+
+static Point intersection(const Point &p1, const Point &p2, const Point &q1,
+                          const Point &q2) {
+    Point i;
+    Scalar a1, b1, c1, a2, b2, c2, det;
+    a1 = p2.y - p1.y;
+    b1 = p1.x - p2.x;
+    c1 = a1 * p1.x + b1 * p1.y;
+    a2 = q2.y - q1.y;
+    b2 = q1.x - q2.x;
+    c2 = a2 * q1.x + b2 * q1.y;
+    det = a1 * b2 - a2 * b1;
+    if (!eq(det, 0)) { // lines are not parallel
+        i.x = (b2 * c1 - b1 * c2) / det;
+        i.y = (a1 * c2 - a2 * c1) / det;
+    }
+    return i;
+}
+
+namespace {
+
+// Vertex ids below n address the input array, the rest address
+// out.steinerPoints, as in the indexed output.
+class Decomposer {
+public:
+    Decomposer(const Point *verts, size_t n, Decomposition &out, const CancelToken *token)
+        : verts(verts), n(n), out(out), token(token), firstPiece(out.pieces()),
+          adjacency(out.output & Decomposition::Adjacency),
+          merging(out.output & Decomposition::Merged) {}
+
+    void decompose(Ring poly);
+    void mergePieces();
+    void linkPieces();
+
+private:
+    const Point *verts;
+    size_t n;
+    Decomposition &out;
+    const CancelToken *token;
+    uint32_t firstPiece, emitted = 0;
+
+    // Diagonals by endpoints, and every ring edge lying on one mapped to it.
+    // A piece edge found in the map is one side of a portal.
+    struct Side {
+        uint32_t diagonal, piece, a, b;
+    };
+    bool adjacency, merging;
+    vector<pair<uint32_t, uint32_t>> diagonals;
+    vector<Ring> held; // pieces waiting to be merged
+    unordered_map<uint64_t, uint32_t> diagonalEdges;
+    vector<Side> sides;
+
+    static uint64_t edgeKey(uint32_t a, uint32_t b) {
+        return a < b ? uint64_t(a) << 32 | b : uint64_t(b) << 32 | a;
+    }
+    void addDiagonal(uint32_t a, uint32_t b) {
+        if (adjacency) {
+            diagonalEdges[edgeKey(a, b)] = diagonals.size();
+            diagonals.emplace_back(a, b);
+        }
+    }
+    void splitEdge(uint32_t a, uint32_t b, uint32_t steiner);
+
+    Point vertex(uint32_t id) const {
+        return id < n ? verts[id] : out.steinerPoints[id - n];
+    }
+    Point at(const Ring &poly, int i) const {
+        return vertex(poly[wrap(i, poly.size())]);
+    }
+    bool isReflex(const Ring &poly, int i) const {
+        return right(at(poly, i - 1), at(poly, i), at(poly, i + 1));
+    }
+    bool canSee(const Ring &poly, int i, int j) const;
+    uint32_t addSteiner(const Point &p) {
+        out.steinerPoints.push_back(p);
+        return n + out.steinerPoints.size() - 1;
+    }
+    void emit(const Ring &poly);
+    void giveUp(const Ring &poly);
+    void triangulate(const Ring &poly);
+};
+
+void Decomposer::splitEdge(uint32_t a, uint32_t b, uint32_t steiner) {
+    if (!adjacency) {
+        return;
+    }
+    auto it = diagonalEdges.find(edgeKey(a, b));
+    if (it != diagonalEdges.end()) {
+        uint32_t diagonal = it->second;
+        diagonalEdges[edgeKey(a, steiner)] = diagonal;
+        diagonalEdges[edgeKey(steiner, b)] = diagonal;
+    }
+}
+
+void Decomposer::emit(const Ring &poly) {
+    if (merging) {
+        held.push_back(poly);
+        return;
+    }
+    uint32_t piece = firstPiece + emitted++;
+    for (size_t i = 0; adjacency && i < poly.size(); ++i) {
+        uint32_t a = poly[i], b = poly[(i + 1) % poly.size()];
+        auto it = diagonalEdges.find(edgeKey(a, b));
+        if (it != diagonalEdges.end()) {
+            sides.push_back({it->second, piece, a, b});
+        }
+    }
+    if (out.output & Decomposition::Indices) {
+        if (out.firstIndex.empty()) {
+            out.firstIndex.push_back(0);
+        }
+        out.indices.insert(out.indices.end(), poly.begin(), poly.end());
+        out.firstIndex.push_back(out.indices.size());
+    }
+    if (out.wantsPolygons()) {
+        Polygon piece;
+        piece.reserve(poly.size());
+        for (uint32_t id : poly) {
+            piece.push_back(vertex(id));
+        }
+        out.addPolygon(piece);
+    }
+}
+
+// Deals with a sub-polygon the token did not leave time to split.
+void Decomposer::giveUp(const Ring &poly) {
+    out.truncated = true;
+    if (token->fallback == CancelToken::KeepRemainder) {
+        out.remainder.emplace_back();
+        for (uint32_t id : poly) {
+            out.remainder.back().push_back(vertex(id));
+        }
+        return;
+    }
+    triangulate(poly);
+}
+
+// Earcut triangles are convex pieces too, and their inner edges become
+// diagonals so the adjacency stays complete.
+void Decomposer::triangulate(const Ring &poly) {
+    vector<vector<Point>> rings(1);
+    for (uint32_t id : poly) {
+        rings[0].push_back(vertex(id));
+    }
+    vector<uint32_t> triangles = mapbox::earcut<uint32_t, PointLayout>(rings);
+    for (uint32_t &k : triangles) {
+        k = poly[k];
+    }
+    if (adjacency) {
+        unordered_map<uint64_t, int> seen;
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            uint32_t a = triangles[i], b = triangles[i - i % 3 + (i + 1) % 3];
+            if (++seen[edgeKey(a, b)] == 2) {
+                addDiagonal(a, b);
+            }
+        }
+    }
+    for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+        Ring triangle(&triangles[i], &triangles[i] + 3);
+        if (!left(vertex(triangle[0]), vertex(triangle[1]), vertex(triangle[2]))) {
+            swap(triangle[1], triangle[2]);
+        }
+        emit(triangle);
+    }
+}
+
+// whether the diagonal i-j stays clear of every edge not incident to i or j
+bool Decomposer::canSee(const Ring &poly, int i, int j) const {
+    int size = poly.size();
+    Point a = at(poly, i), b = at(poly, j);
+    for (int k = 0; k < size; ++k) {
+        int k1 = (k + 1) % size;
+        if (k == i || k == j || k1 == i || k1 == j) {
+            continue;
+        }
+        Point c = at(poly, k), e = at(poly, k1);
+        if (leftOn(a, b, c) != leftOn(a, b, e) && leftOn(c, e, a) != leftOn(c, e, b)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Decomposer::decompose(Ring poly) {
+    Point upperInt, lowerInt, p, closestVert;
+    Scalar upperDist, lowerDist, d, closestDist;
+    int upperIndex, lowerIndex, closestIndex;
+    Ring lowerPoly, upperPoly;
+
+    // duplicate and collinear vertices only produce zero-area splits and slivers
+    cleanRing(poly, [this](uint32_t id) { return vertex(id); });
+    if (poly.size() < 3)
+        return;
+    if (token && token->expired()) {
+        giveUp(poly);
+        return;
+    }
+
+    for (int i = 0; i < poly.size(); ++i) {
+        if (isReflex(poly, i)) {
+            out.reflexVertices.push_back(at(poly, i));
+            upperDist = lowerDist = numeric_limits<Scalar>::max();
+            upperIndex = lowerIndex = closestIndex = -1;
+            for (int j = 0; j < poly.size(); ++j) {
+                if (left(at(poly, i - 1), at(poly, i), at(poly, j)) &&
+                    rightOn(at(poly, i - 1), at(poly, i),
+                            at(poly, j - 1))) { // if line intersects with an edge
+                    p = intersection(at(poly, i - 1), at(poly, i), at(poly, j),
+                                     at(poly, j - 1)); // find the point of intersection
+                    if (right(at(poly, i + 1), at(poly, i),
+                              p)) { // make sure it's inside the poly
+                        d = sqdist(at(poly, i), p);
+                        if (d < lowerDist) { // keep only the closest intersection
+                            lowerDist = d;
+                            lowerInt = p;
+                            lowerIndex = j;
+                        }
+                    }
+                }
+                if (left(at(poly, i + 1), at(poly, i), at(poly, j + 1)) &&
+                    rightOn(at(poly, i + 1), at(poly, i), at(poly, j))) {
+                    p = intersection(at(poly, i + 1), at(poly, i), at(poly, j),
+                                     at(poly, j + 1));
+                    if (left(at(poly, i - 1), at(poly, i), p)) {
+                        d = sqdist(at(poly, i), p);
+                        if (d < upperDist) {
+                            upperDist = d;
+                            upperInt = p;
+                            upperIndex = j;
+                        }
+                    }
+                }
+            }
+
+            // rounding can hide the edges hit by the extended sides; the
+            // sub-polygon is triangulated rather than split at an arbitrary
+            // index, or handed out whole while it is not convex
+            if (lowerIndex < 0 || upperIndex < 0) {
+                triangulate(poly);
+                return;
+            }
+
+            // if there are no vertices to connect to, choose a point in the middle
+            if (lowerIndex == (upperIndex + 1) % poly.size()) {
+                p.x = (lowerInt.x + upperInt.x) / 2;
+                p.y = (lowerInt.y + upperInt.y) / 2;
+                uint32_t steiner = addSteiner(p);
+                splitEdge(poly[upperIndex], poly[lowerIndex], steiner);
+                addDiagonal(poly[i], steiner);
+
+                if (i < upperIndex) {
+                    lowerPoly.insert(lowerPoly.end(), poly.begin() + i,
+                                     poly.begin() + upperIndex + 1);
+                    lowerPoly.push_back(steiner);
+                    upperPoly.push_back(steiner);
+                    if (lowerIndex != 0)
+                        upperPoly.insert(upperPoly.end(), poly.begin() + lowerIndex,
+                                         poly.end());
+                    upperPoly.insert(upperPoly.end(), poly.begin(), poly.begin() + i + 1);
+                } else {
+                    if (i != 0)
+                        lowerPoly.insert(lowerPoly.end(), poly.begin() + i, poly.end());
+                    lowerPoly.insert(lowerPoly.end(), poly.begin(),
+                                     poly.begin() + upperIndex + 1);
+                    lowerPoly.push_back(steiner);
+                    upperPoly.push_back(steiner);
+                    upperPoly.insert(upperPoly.end(), poly.begin() + lowerIndex,
+                                     poly.begin() + i + 1);
+                }
+            } else {
+                // connect to the closest point within the triangle
+                if (lowerIndex > upperIndex) {
+                    upperIndex += poly.size();
+                }
+                closestDist = numeric_limits<Scalar>::max();
+                for (int j = lowerIndex; j <= upperIndex; ++j) {
+                    if (leftOn(at(poly, i - 1), at(poly, i), at(poly, j)) &&
+                        rightOn(at(poly, i + 1), at(poly, i), at(poly, j))) {
+                        d = sqdist(at(poly, i), at(poly, j));
+                        if (d < closestDist && canSee(poly, i, j % poly.size())) {
+                            closestDist = d;
+                            closestVert = at(poly, j);
+                            closestIndex = j % poly.size();
+                        }
+                    }
+                }
+                if (closestIndex < 0) {
+                    triangulate(poly);
+                    return;
+                }
+                addDiagonal(poly[i], poly[closestIndex]);
+
+                if (i < closestIndex) {
+                    lowerPoly.insert(lowerPoly.end(), poly.begin() + i,
+                                     poly.begin() + closestIndex + 1);
+                    if (closestIndex != 0)
+                        upperPoly.insert(upperPoly.end(), poly.begin() + closestIndex,
+                                         poly.end());
+                    upperPoly.insert(upperPoly.end(), poly.begin(), poly.begin() + i + 1);
+                } else {
+                    if (i != 0)
+                        lowerPoly.insert(lowerPoly.end(), poly.begin() + i, poly.end());
+                    lowerPoly.insert(lowerPoly.end(), poly.begin(),
+                                     poly.begin() + closestIndex + 1);
+                    upperPoly.insert(upperPoly.end(), poly.begin() + closestIndex,
+                                     poly.begin() + i + 1);
+                }
+            }
+
+            // solve smallest poly first
+            if (lowerPoly.size() < upperPoly.size()) {
+                decompose(lowerPoly);
+                decompose(upperPoly);
+            } else {
+                decompose(upperPoly);
+                decompose(lowerPoly);
+            }
+            return;
+        }
+    }
+    emit(poly);
+}
+
+// Fuses the held pieces across the diagonals they share and emits what is
+// left. Pieces only ever share diagonals, so every edge is a candidate.
+void Decomposer::mergePieces() {
+    out.merged += mergeNeighbors(held, [this](uint32_t id) { return vertex(id); },
+                                 [](uint32_t, uint32_t) { return true; }, true);
+    merging = false;
+    for (const Ring &piece : held) {
+        if (!piece.empty()) {
+            emit(piece);
+        }
+    }
+    held.clear();
+}
+
+// Pairs up the pieces on either side of every diagonal. Each side covers the
+// diagonal with one or more segments; wherever segments of opposite sides
+// overlap, their pieces share that stretch as a portal.
+void Decomposer::linkPieces() {
+    if (out.firstNeighbor.empty()) {
+        out.firstNeighbor.push_back(0);
+    }
+    out.firstNeighbor.resize(firstPiece + 1, out.neighbors.size());
+
+    struct Span {
+        Scalar from, to;
+        uint32_t piece, start, end;
+    };
+    struct Link {
+        uint32_t piece, other, a, b;
+    };
+    vector<Link> links;
+    vector<Span> spans[2];
+
+    sort(sides.begin(), sides.end(),
+         [](const Side &l, const Side &r) { return l.diagonal < r.diagonal; });
+    for (size_t first = 0, last; first < sides.size(); first = last) {
+        for (last = first; last < sides.size() && sides[last].diagonal == sides[first].diagonal;
+             ++last) {
+        }
+        Point u = vertex(diagonals[sides[first].diagonal].first);
+        Point v = vertex(diagonals[sides[first].diagonal].second);
+        Scalar dx = v.x - u.x, dy = v.y - u.y;
+        auto along = [&](uint32_t id) {
+            Point p = vertex(id);
+            return (p.x - u.x) * dx + (p.y - u.y) * dy;
+        };
+
+        // pieces are counter-clockwise, so the sides run the diagonal in
+        // opposite directions
+        spans[0].clear();
+        spans[1].clear();
+        for (size_t k = first; k < last; ++k) {
+            const Side &side = sides[k];
+            Scalar ta = along(side.a), tb = along(side.b);
+            if (ta < tb) {
+                spans[0].push_back({ta, tb, side.piece, side.a, side.b});
+            } else {
+                spans[1].push_back({tb, ta, side.piece, side.b, side.a});
+            }
+        }
+        for (vector<Span> &list : spans) {
+            sort(list.begin(), list.end(),
+                 [](const Span &l, const Span &r) { return l.from < r.from; });
+        }
+        for (size_t i = 0, j = 0; i < spans[0].size() && j < spans[1].size();) {
+            const Span &l = spans[0][i], &r = spans[1][j];
+            if (min(l.to, r.to) > max(l.from, r.from)) {
+                uint32_t a = l.from > r.from ? l.start : r.start;
+                uint32_t b = l.to < r.to ? l.end : r.end;
+                links.push_back({l.piece, r.piece, a, b});
+                links.push_back({r.piece, l.piece, b, a});
+            }
+            l.to < r.to ? ++i : ++j;
+        }
+    }
+
+    sort(links.begin(), links.end(),
+         [](const Link &l, const Link &r) { return l.piece < r.piece; });
+    size_t k = 0;
+    for (uint32_t piece = firstPiece; piece < firstPiece + emitted; ++piece) {
+        for (; k < links.size() && links[k].piece == piece; ++k) {
+            out.neighbors.push_back({links[k].other, vertex(links[k].a), vertex(links[k].b)});
+        }
+        out.firstNeighbor.push_back(out.neighbors.size());
+    }
+}
+
+} // namespace
+
+void decomposePoly(const Point *verts, size_t n, Decomposition &out, const CancelToken *token) {
+    // clockwise input is walked backwards instead of being reversed in place
+    double sum = 0;
+    for (size_t i = 0, j = n - 1; i < n; j = i++) {
+        sum += (double(verts[j].x) - verts[i].x) * (double(verts[i].y) + verts[j].y);
+    }
+    Ring poly(n);
+    for (size_t i = 0; i < n; ++i) {
+        poly[i] = sum < 0 ? n - 1 - i : i;
+    }
+    Decomposer decomposer(verts, n, out, token);
+    decomposer.decompose(poly);
+    if (out.output & Decomposition::Merged) {
+        decomposer.mergePieces();
+    }
+    if (out.output & Decomposition::Adjacency) {
+        decomposer.linkPieces();
+    }
+}
+
+void decomposePoly(const Polygon &poly, Decomposition &out, const CancelToken *token) {
+    decomposePoly(poly.data(), poly.size(), out, token);
+}
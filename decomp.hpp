@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include "point.hpp"
+
+// Convex pieces of a polygon plus the points the decomposition introduced
+// (Steiner points) and the reflex vertices it resolved.
+//
+// Pieces come as coordinate copies in polys, as index lists, or both. Index
+// lists share every vertex: id i < n is vertex i of the n input vertices and
+// id n + k is steinerPoints[k], so the input followed by the Steiner points
+// makes one vertex buffer for all pieces.
+//
+// Adjacency adds the graph of pieces sharing a diagonal, alongside either
+// representation: the neighbors of piece i are neighbors[firstNeighbor[i]]
+// up to firstNeighbor[i + 1], each with the portal segment a-b the two pieces
+// have in common. A Steiner point placed on a diagonal from one side splits
+// its portal in two.
+//
+// With a sink, every piece is also handed over the moment it is final, in
+// the order the decomposition finds them, so consumers can start on the
+// first pieces while the rest are worked out. Output may then leave out
+// Polygons to stream the pieces without keeping them.
+//
+// Merged fuses neighboring pieces across their diagonals wherever the union
+// is still convex, counting the pieces saved in merged, so pieces() + merged
+// is what the decomposition gave. Vertices left straight by a merge stay in
+// the piece. The pieces of a polygon are held back until it is fully split,
+// so a sink only sees them at the end.
+//
+// A decomposition stopped by its CancelToken is truncated: the sub-polygons
+// not split yet are either triangulated into pieces or left in remainder,
+// counter-clockwise and possibly still non-convex.
+class Decomposition {
+public:
+    enum Output { Polygons = 1, Indices = 2, Adjacency = 4, Merged = 8 };
+    // which of the representations decomposePoly fills in, and whether merged
+    int output = Polygons;
+    // called on the decomposing thread, kept by clear()
+    function<void(const Polygon &piece)> sink;
+
+    struct Neighbor {
+        uint32_t piece;
+        Point a, b;
+    };
+
+    vector<Polygon> polys;
+    // piece i is indices[firstIndex[i]] up to firstIndex[i + 1]
+    vector<uint32_t> indices, firstIndex;
+    vector<Neighbor> neighbors;
+    vector<uint32_t> firstNeighbor;
+    vector<Point> steinerPoints, reflexVertices;
+    vector<Polygon> remainder;
+    bool truncated = false;
+    uint32_t merged = 0;
+
+    size_t pieces() const;
+    void clear();
+
+    // whether pieces are wanted as coordinates, by polys or the sink
+    bool wantsPolygons() const { return (output & Polygons) || sink; }
+    // streams a finished piece and keeps it if polys are wanted
+    void addPolygon(Polygon &piece);
+};
+
+// Stops a decomposition between two splits once it is cancelled, from any
+// thread, or once its deadline has passed. The deadline and fallback are set
+// before the decomposition starts.
+class CancelToken {
+public:
+    // what becomes of the sub-polygons left when the token fires
+    enum Fallback { Triangulate, KeepRemainder };
+    Fallback fallback = Triangulate;
+
+    CancelToken() {}
+    // fires once the budget from now has been used up
+    explicit CancelToken(chrono::steady_clock::duration budget)
+        : deadline(chrono::steady_clock::now() + budget) {}
+
+    void setDeadline(chrono::steady_clock::time_point when) { deadline = when; }
+    void cancel() { cancelled.store(true, memory_order_relaxed); }
+
+    bool expired() const {
+        return cancelled.load(memory_order_relaxed) ||
+               (deadline != chrono::steady_clock::time_point::max() &&
+                chrono::steady_clock::now() >= deadline);
+    }
+
+private:
+    atomic<bool> cancelled{false};
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max();
+};
+
+void makeCCW(Polygon &poly);
+bool isReflex(const Polygon &poly, const int &i);
+
+// Bayazit's decomposition of a simple polygon into counter-clockwise convex
+// pieces, appended to out. The vertices are only read, so they can point
+// straight into a mapped file: the recursion works on index lists into them
+// and walks clockwise input backwards. With a token the work is bounded by
+// its deadline, see Decomposition for what a truncated result holds.
+void decomposePoly(const Point *verts, size_t n, Decomposition &out,
+                   const CancelToken *token = nullptr);
+void decomposePoly(const Polygon &poly, Decomposition &out, const CancelToken *token = nullptr);
@@ -0,0 +1,228 @@
+#include "dispatch.hpp"
+
+#include <limits>
+
+#include "engine.hpp"
+#include "simplify.hpp"
+
+typedef vector<uint32_t> Ring;
+
+Algorithm route(const InputFeatures &features, const RoutingPolicy &policy) {
+    if (features.rings > 1) {
+        return Algorithm::Earcut;
+    }
+    if (features.reflex == 0) {
+        return Algorithm::Passthrough;
+    }
+    if (features.reflex == 1 && policy.singleSplit) {
+        return Algorithm::SingleSplit;
+    }
+    if (policy.model) {
+        double earcut = policy.model->predict(features, Algorithm::Earcut);
+        double bayazit = policy.model->predict(features, Algorithm::Bayazit);
+        return earcut * policy.earcutSpeedup < bayazit ? Algorithm::Earcut : Algorithm::Bayazit;
+    }
+    if (features.vertices >= policy.earcutVertices &&
+        features.reflexRatio() >= policy.earcutReflexRatio) {
+        return Algorithm::Earcut;
+    }
+    return Algorithm::Bayazit;
+}
+
+const char *algorithmName(Algorithm algorithm) {
+    switch (algorithm) {
+    case Algorithm::Passthrough:
+        return "passthrough";
+    case Algorithm::SingleSplit:
+        return "single split";
+    case Algorithm::Bayazit:
+        return "bayazit";
+    case Algorithm::Earcut:
+        return "earcut";
+    }
+    return "";
+}
+
+namespace {
+
+// Counter-clockwise outline as vertex ids, walking clockwise input
+// backwards like decomposePoly, with repeated and collinear vertices
+// dropped.
+class Outline {
+public:
+    explicit Outline(const Polygon &verts) : verts(verts) {
+        size_t n = verts.size();
+        double sum = 0;
+        for (size_t i = 0, j = n - 1; i < n; j = i++) {
+            sum += (double(verts[j].x) - verts[i].x) * (double(verts[i].y) + verts[j].y);
+        }
+        ring.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            ring[i] = sum < 0 ? n - 1 - i : i;
+        }
+        cleanRing(ring, [&](uint32_t id) { return verts[id]; });
+    }
+
+    const Point &at(int i) const { return verts[ring[wrap(i, ring.size())]]; }
+
+    // whether every turn is a left turn and the ring winds around once: a
+    // convex ring changes its x direction at most twice
+    bool convex() const;
+    // the pieces of a ring whose only reflex vertex is i, or false if no
+    // vertex lies in the wedge a diagonal from i must end in
+    bool splitAt(int i, Ring &lower, Ring &upper) const;
+
+    const Polygon &verts;
+    Ring ring;
+};
+
+bool Outline::convex() const {
+    int n = ring.size(), turns = 0;
+    Scalar last = 0;
+    for (int i = 0; i < n; ++i) {
+        if (right(at(i - 1), at(i), at(i + 1))) {
+            return false;
+        }
+        Scalar dx = at(i + 1).x - at(i).x;
+        if (dx != 0) {
+            turns += last != 0 && (dx > 0) != (last > 0);
+            last = dx;
+        }
+    }
+    // the wrap from the last direction back to the first
+    for (int i = 0; i < n; ++i) {
+        Scalar dx = at(i + 1).x - at(i).x;
+        if (dx != 0) {
+            turns += (dx > 0) != (last > 0);
+            break;
+        }
+    }
+    return n >= 3 && turns <= 2;
+}
+
+// With one reflex vertex every other vertex is in sight of it, and a
+// diagonal to a vertex inside the wedge between its extended edges leaves
+// no angle above 180 degrees on either side.
+bool Outline::splitAt(int i, Ring &lower, Ring &upper) const {
+    int n = ring.size(), closest = -1;
+    Scalar closestDist = numeric_limits<Scalar>::max();
+    for (int j = 0; j < n; ++j) {
+        if (j != i && leftOn(at(i - 1), at(i), at(j)) && rightOn(at(i + 1), at(i), at(j))) {
+            Scalar d = sqdist(at(i), at(j));
+            if (d < closestDist) {
+                closestDist = d;
+                closest = j;
+            }
+        }
+    }
+    if (closest < 0) {
+        return false;
+    }
+    lower.clear();
+    upper.clear();
+    for (int k = i;; k = (k + 1) % n) {
+        lower.push_back(ring[k]);
+        if (k == closest) {
+            break;
+        }
+    }
+    for (int k = closest;; k = (k + 1) % n) {
+        upper.push_back(ring[k]);
+        if (k == i) {
+            break;
+        }
+    }
+    return true;
+}
+
+// writes one piece of input vertex ids to out, like decomposePoly
+void emit(const Polygon &verts, const Ring &piece, Decomposition &out) {
+    if (out.output & Decomposition::Indices) {
+        if (out.firstIndex.empty()) {
+            out.firstIndex.push_back(0);
+        }
+        out.indices.insert(out.indices.end(), piece.begin(), piece.end());
+        out.firstIndex.push_back(out.indices.size());
+    }
+    if (out.wantsPolygons()) {
+        Polygon poly;
+        poly.reserve(piece.size());
+        for (uint32_t id : piece) {
+            poly.push_back(verts[id]);
+        }
+        out.addPolygon(poly);
+    }
+}
+
+void startAdjacency(Decomposition &out, uint32_t firstPiece) {
+    if (out.firstNeighbor.empty()) {
+        out.firstNeighbor.push_back(0);
+    }
+    out.firstNeighbor.resize(firstPiece + 1, out.neighbors.size());
+}
+
+bool passThrough(const Outline &outline, Decomposition &out) {
+    if (!outline.convex()) {
+        return false;
+    }
+    uint32_t firstPiece = out.pieces();
+    emit(outline.verts, outline.ring, out);
+    if (out.output & Decomposition::Adjacency) {
+        startAdjacency(out, firstPiece);
+        out.firstNeighbor.push_back(out.neighbors.size());
+    }
+    return true;
+}
+
+bool splitOnce(const Outline &outline, Decomposition &out) {
+    int reflex = -1;
+    for (int i = 0; i < int(outline.ring.size()); ++i) {
+        if (right(outline.at(i - 1), outline.at(i), outline.at(i + 1))) {
+            if (reflex >= 0) {
+                return false;
+            }
+            reflex = i;
+        }
+    }
+    Ring lower, upper;
+    if (reflex < 0 || !outline.splitAt(reflex, lower, upper)) {
+        return false;
+    }
+    uint32_t firstPiece = out.pieces();
+    out.reflexVertices.push_back(outline.at(reflex));
+    emit(outline.verts, lower, out);
+    emit(outline.verts, upper, out);
+    if (out.output & Decomposition::Adjacency) {
+        // lower ends with the diagonal back to the reflex vertex, upper
+        // starts along it
+        const Point &a = outline.verts[lower.back()], &b = outline.verts[lower.front()];
+        startAdjacency(out, firstPiece);
+        out.neighbors.push_back({firstPiece + 1, a, b});
+        out.firstNeighbor.push_back(out.neighbors.size());
+        out.neighbors.push_back({firstPiece, b, a});
+        out.firstNeighbor.push_back(out.neighbors.size());
+    }
+    return true;
+}
+
+} // namespace
+
+Algorithm decomposeAuto(const Rings &rings, Decomposition &out, const RoutingPolicy &policy,
+                        DecompositionCache *cache, const CancelToken *token) {
+    InputFeatures features = inputFeatures(rings);
+    Algorithm algorithm = route(features, policy);
+    if (algorithm == Algorithm::Earcut) {
+        triangulateRings(rings, out);
+        return algorithm;
+    }
+    if (rings.size() == 1 &&
+        (algorithm == Algorithm::Passthrough || algorithm == Algorithm::SingleSplit)) {
+        Outline outline(rings[0]);
+        if (algorithm == Algorithm::Passthrough ? passThrough(outline, out)
+                                                : splitOnce(outline, out)) {
+            return algorithm;
+        }
+    }
+    decomposeRings(rings, out, cache, token);
+    return rings.size() > 1 ? Algorithm::Earcut : Algorithm::Bayazit;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "cache.hpp"
+#include "metrics.hpp"
+
+// Which algorithm decomposeAuto picks for an input:
+//
+// - convex outlines pass through as their own piece;
+// - outlines with a single reflex vertex are split by one diagonal;
+// - large outlines with many reflex vertices become earcut triangles, as
+//   do polygons with holes;
+// - everything else goes through Bayazit's decomposition.
+struct RoutingPolicy {
+    bool singleSplit = true;
+    // outlines with at least this many vertices, and at least this share of
+    // them reflex, are triangulated
+    size_t earcutVertices = 50000;
+    double earcutReflexRatio = 0.25;
+    // With a cost model its predictions replace the two thresholds: an
+    // outline is triangulated once earcut is predicted to be earcutSpeedup
+    // times faster than Bayazit. Not owned.
+    const CostModel *model = nullptr;
+    double earcutSpeedup = 8;
+};
+
+Algorithm route(const InputFeatures &features, const RoutingPolicy &policy);
+
+// Decomposes rings like decomposeRings along the route the policy picks
+// from the input features, and returns the path taken. Inputs routed past
+// Bayazit fall back to it when their shortcut does not apply: a convex
+// outline that winds around more than once, or a single reflex vertex with
+// no vertex to split at, which needs a Steiner point.
+Algorithm decomposeAuto(const Rings &rings, Decomposition &out,
+                        const RoutingPolicy &policy = RoutingPolicy(),
+                        DecompositionCache *cache = nullptr, const CancelToken *token = nullptr);
+
+const char *algorithmName(Algorithm algorithm);
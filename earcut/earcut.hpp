@@ -3,6 +3,8 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -19,16 +21,50 @@ template <std::size_t I, typename T> struct nth {
 
 namespace detail {
 
-template <typename N = uint32_t>
-class Earcut {
+template <typename T, typename Alloc = std::allocator<T>>
+class ObjectPool {
 public:
-    std::vector<N> indices;
-    std::size_t vertices = 0;
-
-    template <typename Polygon>
-    void operator()(const Polygon& points);
-
+    ObjectPool() { }
+    ObjectPool(std::size_t blockSize_) {
+        reset(blockSize_);
+    }
+    ~ObjectPool() {
+        clear();
+    }
+    template <typename... Args>
+    T* construct(Args&&... args) {
+        if (currentIndex >= blockSize) {
+            currentBlock = alloc_traits::allocate(alloc, blockSize);
+            allocations.emplace_back(currentBlock);
+            currentIndex = 0;
+        }
+        T* object = &currentBlock[currentIndex++];
+        alloc_traits::construct(alloc, object, std::forward<Args>(args)...);
+        return object;
+    }
+    void reset(std::size_t newBlockSize) {
+        for (auto allocation : allocations) {
+            alloc_traits::deallocate(alloc, allocation, blockSize);
+        }
+        allocations.clear();
+        blockSize = std::max<std::size_t>(1, newBlockSize);
+        currentBlock = nullptr;
+        currentIndex = blockSize;
+    }
+    void clear() { reset(blockSize); }
 private:
+    T* currentBlock = nullptr;
+    std::size_t currentIndex = 1;
+    std::size_t blockSize = 1;
+    std::vector<T*> allocations;
+    Alloc alloc;
+    typedef typename std::allocator_traits<Alloc> alloc_traits;
+};
+
+// node storage used by default: every vertex is a heap node linked by pointers
+template <typename N>
+class PointerNodes {
+public:
     struct Node {
         Node(N index, double x_, double y_) : i(index), x(x_), y(y_) {}
         Node(const Node&) = delete;
@@ -55,92 +91,180 @@ private:
         bool steiner = false;
     };
 
-    template <typename Ring> Node* linkedList(const Ring& points, const bool clockwise);
-    Node* filterPoints(Node* start, Node* end = nullptr);
-    void earcutLinked(Node* ear, int pass = 0);
-    bool isEar(Node* ear);
-    bool isEarHashed(Node* ear);
-    Node* cureLocalIntersections(Node* start);
-    void splitEarcut(Node* start);
-    template <typename Polygon> Node* eliminateHoles(const Polygon& points, Node* outerNode);
-    void eliminateHole(Node* hole, Node* outerNode);
-    Node* findHoleBridge(Node* hole, Node* outerNode);
-    bool sectorContainsSector(const Node* m, const Node* p);
-    void indexCurve(Node* start);
-    Node* sortLinked(Node* list);
+    // a default-constructed Ref is the null node
+    typedef Node* Ref;
+    typedef double Coord;
+
+    Ref construct(N index, Coord x_, Coord y_) { return pool.construct(index, x_, y_); }
+    void reset(std::size_t size) { pool.reset(size); }
+    void clear() { pool.clear(); }
+
+    N index(Ref p) const { return p->i; }
+    double x(Ref p) const { return p->x; }
+    double y(Ref p) const { return p->y; }
+    Ref& prev(Ref p) { return p->prev; }
+    Ref& next(Ref p) { return p->next; }
+    int32_t& z(Ref p) { return p->z; }
+    Ref& prevZ(Ref p) { return p->prevZ; }
+    Ref& nextZ(Ref p) { return p->nextZ; }
+    bool& steiner(Ref p) { return p->steiner; }
+
+private:
+    ObjectPool<Node> pool;
+};
+
+// compact node storage: nodes are 32-bit indices into structure-of-arrays fields, so a
+// node costs ~33 bytes with float coordinates instead of ~72 and z-order walks stay in
+// a few dense arrays; slot 0 is reserved as the null node
+template <typename N, typename C>
+class IndexedNodes {
+public:
+    typedef uint32_t Ref;
+    typedef C Coord;
+
+    Ref construct(N index_, Coord x_, Coord y_) {
+        assert(ids.size() < std::numeric_limits<Ref>::max());
+        const Ref p = static_cast<Ref>(ids.size());
+        ids.push_back(index_);
+        xs.push_back(x_);
+        ys.push_back(y_);
+        prevs.push_back(0);
+        nexts.push_back(0);
+        zs.push_back(0);
+        prevZs.push_back(0);
+        nextZs.push_back(0);
+        steiners.push_back(false);
+        return p;
+    }
+    void reset(std::size_t size) {
+        clear();
+        ids.reserve(size + 1);
+        xs.reserve(size + 1);
+        ys.reserve(size + 1);
+        prevs.reserve(size + 1);
+        nexts.reserve(size + 1);
+        zs.reserve(size + 1);
+        prevZs.reserve(size + 1);
+        nextZs.reserve(size + 1);
+        steiners.reserve(size + 1);
+        construct(N(), Coord(), Coord());
+    }
+    void clear() {
+        ids.clear();
+        xs.clear();
+        ys.clear();
+        prevs.clear();
+        nexts.clear();
+        zs.clear();
+        prevZs.clear();
+        nextZs.clear();
+        steiners.clear();
+    }
+
+    N index(Ref p) const { return ids[p]; }
+    double x(Ref p) const { return xs[p]; }
+    double y(Ref p) const { return ys[p]; }
+    Ref& prev(Ref p) { return prevs[p]; }
+    Ref& next(Ref p) { return nexts[p]; }
+    int32_t& z(Ref p) { return zs[p]; }
+    Ref& prevZ(Ref p) { return prevZs[p]; }
+    Ref& nextZ(Ref p) { return nextZs[p]; }
+    uint8_t& steiner(Ref p) { return steiners[p]; }
+
+private:
+    std::vector<N> ids;
+    std::vector<Coord> xs;
+    std::vector<Coord> ys;
+    std::vector<Ref> prevs;
+    std::vector<Ref> nexts;
+    std::vector<int32_t> zs;
+    std::vector<Ref> prevZs;
+    std::vector<Ref> nextZs;
+    std::vector<uint8_t> steiners;
+};
+
+}
+
+// node layouts for mapbox::earcut<N, Layout>; PointerLayout is the original one
+struct PointerLayout {
+    template <typename N> using Nodes = detail::PointerNodes<N>;
+};
+
+template <typename Coord = double>
+struct IndexedLayout {
+    template <typename N> using Nodes = detail::IndexedNodes<N, Coord>;
+};
+
+namespace detail {
+
+template <typename N = uint32_t, typename Layout = PointerLayout>
+class Earcut : private Layout::template Nodes<N> {
+public:
+    std::vector<N> indices;
+    std::size_t vertices = 0;
+
+    template <typename Polygon>
+    void operator()(const Polygon& points);
+
+private:
+    typedef typename Layout::template Nodes<N> Nodes;
+    typedef typename Nodes::Ref Ref;
+
+    using Nodes::index;
+    using Nodes::x;
+    using Nodes::y;
+    using Nodes::prev;
+    using Nodes::next;
+    using Nodes::z;
+    using Nodes::prevZ;
+    using Nodes::nextZ;
+    using Nodes::steiner;
+
+    Nodes& nodes() { return *this; }
+
+    template <typename Ring> Ref linkedList(const Ring& points, const bool clockwise);
+    Ref filterPoints(Ref start, Ref end = Ref());
+    void earcutLinked(Ref ear, int pass = 0);
+    bool isEar(Ref ear);
+    bool isEarHashed(Ref ear);
+    Ref cureLocalIntersections(Ref start);
+    void splitEarcut(Ref start);
+    template <typename Polygon> Ref eliminateHoles(const Polygon& points, Ref outerNode);
+    void eliminateHole(Ref hole, Ref outerNode);
+    Ref findHoleBridge(Ref hole, Ref outerNode);
+    bool sectorContainsSector(Ref m, Ref p);
+    void indexCurve(Ref start);
+    Ref sortLinked(Ref list);
     int32_t zOrder(const double x_, const double y_);
-    Node* getLeftmost(Node* start);
+    Ref getLeftmost(Ref start);
     bool pointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py) const;
-    bool isValidDiagonal(Node* a, Node* b);
-    double area(const Node* p, const Node* q, const Node* r) const;
-    bool equals(const Node* p1, const Node* p2);
-    bool intersects(const Node* p1, const Node* q1, const Node* p2, const Node* q2);
-    bool onSegment(const Node* p, const Node* q, const Node* r);
+    bool isValidDiagonal(Ref a, Ref b);
+    double area(Ref p, Ref q, Ref r) const;
+    bool equals(Ref p1, Ref p2);
+    bool intersects(Ref p1, Ref q1, Ref p2, Ref q2);
+    bool onSegment(Ref p, Ref q, Ref r);
     int sign(double val);
-    bool intersectsPolygon(const Node* a, const Node* b);
-    bool locallyInside(const Node* a, const Node* b);
-    bool middleInside(const Node* a, const Node* b);
-    Node* splitPolygon(Node* a, Node* b);
-    template <typename Point> Node* insertNode(std::size_t i, const Point& p, Node* last);
-    void removeNode(Node* p);
+    bool intersectsPolygon(Ref a, Ref b);
+    bool locallyInside(Ref a, Ref b);
+    bool middleInside(Ref a, Ref b);
+    Ref splitPolygon(Ref a, Ref b);
+    template <typename Point> Ref insertNode(std::size_t i, const Point& p, Ref last);
+    void removeNode(Ref p);
 
     bool hashing;
     double minX, maxX;
     double minY, maxY;
     double inv_size = 0;
-
-    template <typename T, typename Alloc = std::allocator<T>>
-    class ObjectPool {
-    public:
-        ObjectPool() { }
-        ObjectPool(std::size_t blockSize_) {
-            reset(blockSize_);
-        }
-        ~ObjectPool() {
-            clear();
-        }
-        template <typename... Args>
-        T* construct(Args&&... args) {
-            if (currentIndex >= blockSize) {
-                currentBlock = alloc_traits::allocate(alloc, blockSize);
-                allocations.emplace_back(currentBlock);
-                currentIndex = 0;
-            }
-            T* object = &currentBlock[currentIndex++];
-            alloc_traits::construct(alloc, object, std::forward<Args>(args)...);
-            return object;
-        }
-        void reset(std::size_t newBlockSize) {
-            for (auto allocation : allocations) {
-                alloc_traits::deallocate(alloc, allocation, blockSize);
-            }
-            allocations.clear();
-            blockSize = std::max<std::size_t>(1, newBlockSize);
-            currentBlock = nullptr;
-            currentIndex = blockSize;
-        }
-        void clear() { reset(blockSize); }
-    private:
-        T* currentBlock = nullptr;
-        std::size_t currentIndex = 1;
-        std::size_t blockSize = 1;
-        std::vector<T*> allocations;
-        Alloc alloc;
-        typedef typename std::allocator_traits<Alloc> alloc_traits;
-    };
-    ObjectPool<Node> nodes;
 };
 
-template <typename N> template <typename Polygon>
-void Earcut<N>::operator()(const Polygon& points) {
+template <typename N, typename Layout> template <typename Polygon>
+void Earcut<N, Layout>::operator()(const Polygon& points) {
     // reset
     indices.clear();
     vertices = 0;
 
     if (points.empty()) return;
 
-    double x;
-    double y;
     int threshold = 80;
     std::size_t len = 0;
 
@@ -150,28 +274,26 @@ void Earcut<N>::operator()(const Polygon& points) {
     }
 
     //estimate size of nodes and indices
-    nodes.reset(len * 3 / 2);
+    nodes().reset(len * 3 / 2);
     indices.reserve(len + points[0].size());
 
-    Node* outerNode = linkedList(points[0], true);
-    if (!outerNode || outerNode->prev == outerNode->next) return;
+    Ref outerNode = linkedList(points[0], true);
+    if (!outerNode || prev(outerNode) == next(outerNode)) return;
 
     if (points.size() > 1) outerNode = eliminateHoles(points, outerNode);
 
     // if the shape is not too simple, we'll use z-order curve hash later; calculate polygon bbox
     hashing = threshold < 0;
     if (hashing) {
-        Node* p = outerNode->next;
-        minX = maxX = outerNode->x;
-        minY = maxY = outerNode->y;
+        Ref p = next(outerNode);
+        minX = maxX = x(outerNode);
+        minY = maxY = y(outerNode);
         do {
-            x = p->x;
-            y = p->y;
-            minX = std::min<double>(minX, x);
-            minY = std::min<double>(minY, y);
-            maxX = std::max<double>(maxX, x);
-            maxY = std::max<double>(maxY, y);
-            p = p->next;
+            minX = std::min<double>(minX, x(p));
+            minY = std::min<double>(minY, y(p));
+            maxX = std::max<double>(maxX, x(p));
+            maxY = std::max<double>(maxY, y(p));
+            p = next(p);
         } while (p != outerNode);
 
         // minX, minY and size are later used to transform coords into integers for z-order calculation
@@ -181,18 +303,18 @@ void Earcut<N>::operator()(const Polygon& points) {
 
     earcutLinked(outerNode);
 
-    nodes.clear();
+    nodes().clear();
 }
 
 // create a circular doubly linked list from polygon points in the specified winding order
-template <typename N> template <typename Ring>
-typename Earcut<N>::Node*
-Earcut<N>::linkedList(const Ring& points, const bool clockwise) {
+template <typename N, typename Layout> template <typename Ring>
+typename Earcut<N, Layout>::Ref
+Earcut<N, Layout>::linkedList(const Ring& points, const bool clockwise) {
     using Point = typename Ring::value_type;
     double sum = 0;
     const std::size_t len = points.size();
     std::size_t i, j;
-    Node* last = nullptr;
+    Ref last = Ref();
 
     // calculate original winding order of a polygon ring
     for (i = 0, j = len > 0 ? len - 1 : 0; i < len; j = i++) {
@@ -212,9 +334,9 @@ Earcut<N>::linkedList(const Ring& points, const bool clockwise) {
         for (i = len; i-- > 0;) last = insertNode(vertices + i, points[i], last);
     }
 
-    if (last && equals(last, last->next)) {
+    if (last && equals(last, next(last))) {
         removeNode(last);
-        last = last->next;
+        last = next(last);
     }
 
     vertices += len;
@@ -223,25 +345,25 @@ Earcut<N>::linkedList(const Ring& points, const bool clockwise) {
 }
 
 // eliminate colinear or duplicate points
-template <typename N>
-typename Earcut<N>::Node*
-Earcut<N>::filterPoints(Node* start, Node* end) {
+template <typename N, typename Layout>
+typename Earcut<N, Layout>::Ref
+Earcut<N, Layout>::filterPoints(Ref start, Ref end) {
     if (!end) end = start;
 
-    Node* p = start;
+    Ref p = start;
     bool again;
     do {
         again = false;
 
-        if (!p->steiner && (equals(p, p->next) || area(p->prev, p, p->next) == 0)) {
+        if (!steiner(p) && (equals(p, next(p)) || area(prev(p), p, next(p)) == 0)) {
             removeNode(p);
-            p = end = p->prev;
+            p = end = prev(p);
 
-            if (p == p->next) break;
+            if (p == next(p)) break;
             again = true;
 
         } else {
-            p = p->next;
+            p = next(p);
         }
     } while (again || p != end);
 
@@ -249,41 +371,41 @@ Earcut<N>::filterPoints(Node* start, Node* end) {
 }
 
 // main ear slicing loop which triangulates a polygon (given as a linked list)
-template <typename N>
-void Earcut<N>::earcutLinked(Node* ear, int pass) {
+template <typename N, typename Layout>
+void Earcut<N, Layout>::earcutLinked(Ref ear, int pass) {
     if (!ear) return;
 
     // interlink polygon nodes in z-order
     if (!pass && hashing) indexCurve(ear);
 
-    Node* stop = ear;
-    Node* prev;
-    Node* next;
+    Ref stop = ear;
+    Ref prevEar;
+    Ref nextEar;
 
     int iterations = 0;
 
     // iterate through ears, slicing them one by one
-    while (ear->prev != ear->next) {
+    while (prev(ear) != next(ear)) {
         iterations++;
-        prev = ear->prev;
-        next = ear->next;
+        prevEar = prev(ear);
+        nextEar = next(ear);
 
         if (hashing ? isEarHashed(ear) : isEar(ear)) {
             // cut off the triangle
-            indices.emplace_back(prev->i);
-            indices.emplace_back(ear->i);
-            indices.emplace_back(next->i);
+            indices.emplace_back(index(prevEar));
+            indices.emplace_back(index(ear));
+            indices.emplace_back(index(nextEar));
 
             removeNode(ear);
 
             // skipping the next vertice leads to less sliver triangles
-            ear = next->next;
-            stop = next->next;
+            ear = next(nextEar);
+            stop = next(nextEar);
 
             continue;
         }
 
-        ear = next;
+        ear = nextEar;
 
         // if we looped through the whole remaining polygon and can't find any more ears
         if (ear == stop) {
@@ -304,189 +426,189 @@ void Earcut<N>::earcutLinked(Node* ear, int pass) {
 }
 
 // check whether a polygon node forms a valid ear with adjacent nodes
-template <typename N>
-bool Earcut<N>::isEar(Node* ear) {
-    const Node* a = ear->prev;
-    const Node* b = ear;
-    const Node* c = ear->next;
+template <typename N, typename Layout>
+bool Earcut<N, Layout>::isEar(Ref ear) {
+    const Ref a = prev(ear);
+    const Ref b = ear;
+    const Ref c = next(ear);
 
     if (area(a, b, c) >= 0) return false; // reflex, can't be an ear
 
     // now make sure we don't have other points inside the potential ear
-    Node* p = ear->next->next;
+    Ref p = next(next(ear));
 
-    while (p != ear->prev) {
-        if (pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
-            area(p->prev, p, p->next) >= 0) return false;
-        p = p->next;
+    while (p != prev(ear)) {
+        if (pointInTriangle(x(a), y(a), x(b), y(b), x(c), y(c), x(p), y(p)) &&
+            area(prev(p), p, next(p)) >= 0) return false;
+        p = next(p);
     }
 
     return true;
 }
 
-template <typename N>
-bool Earcut<N>::isEarHashed(Node* ear) {
-    const Node* a = ear->prev;
-    const Node* b = ear;
-    const Node* c = ear->next;
+template <typename N, typename Layout>
+bool Earcut<N, Layout>::isEarHashed(Ref ear) {
+    const Ref a = prev(ear);
+    const Ref b = ear;
+    const Ref c = next(ear);
 
     if (area(a, b, c) >= 0) return false; // reflex, can't be an ear
 
     // triangle bbox; min & max are calculated like this for speed
-    const double minTX = std::min<double>(a->x, std::min<double>(b->x, c->x));
-    const double minTY = std::min<double>(a->y, std::min<double>(b->y, c->y));
-    const double maxTX = std::max<double>(a->x, std::max<double>(b->x, c->x));
-    const double maxTY = std::max<double>(a->y, std::max<double>(b->y, c->y));
+    const double minTX = std::min<double>(x(a), std::min<double>(x(b), x(c)));
+    const double minTY = std::min<double>(y(a), std::min<double>(y(b), y(c)));
+    const double maxTX = std::max<double>(x(a), std::max<double>(x(b), x(c)));
+    const double maxTY = std::max<double>(y(a), std::max<double>(y(b), y(c)));
 
     // z-order range for the current triangle bbox;
     const int32_t minZ = zOrder(minTX, minTY);
     const int32_t maxZ = zOrder(maxTX, maxTY);
 
     // first look for points inside the triangle in increasing z-order
-    Node* p = ear->nextZ;
+    Ref p = nextZ(ear);
 
-    while (p && p->z <= maxZ) {
-        if (p != ear->prev && p != ear->next &&
-            pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
-            area(p->prev, p, p->next) >= 0) return false;
-        p = p->nextZ;
+    while (p && z(p) <= maxZ) {
+        if (p != a && p != c &&
+            pointInTriangle(x(a), y(a), x(b), y(b), x(c), y(c), x(p), y(p)) &&
+            area(prev(p), p, next(p)) >= 0) return false;
+        p = nextZ(p);
     }
 
     // then look for points in decreasing z-order
-    p = ear->prevZ;
+    p = prevZ(ear);
 
-    while (p && p->z >= minZ) {
-        if (p != ear->prev && p != ear->next &&
-            pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
-            area(p->prev, p, p->next) >= 0) return false;
-        p = p->prevZ;
+    while (p && z(p) >= minZ) {
+        if (p != a && p != c &&
+            pointInTriangle(x(a), y(a), x(b), y(b), x(c), y(c), x(p), y(p)) &&
+            area(prev(p), p, next(p)) >= 0) return false;
+        p = prevZ(p);
     }
 
     return true;
 }
 
 // go through all polygon nodes and cure small local self-intersections
-template <typename N>
-typename Earcut<N>::Node*
-Earcut<N>::cureLocalIntersections(Node* start) {
-    Node* p = start;
+template <typename N, typename Layout>
+typename Earcut<N, Layout>::Ref
+Earcut<N, Layout>::cureLocalIntersections(Ref start) {
+    Ref p = start;
     do {
-        Node* a = p->prev;
-        Node* b = p->next->next;
+        Ref a = prev(p);
+        Ref b = next(next(p));
 
         // a self-intersection where edge (v[i-1],v[i]) intersects (v[i+1],v[i+2])
-        if (!equals(a, b) && intersects(a, p, p->next, b) && locallyInside(a, b) && locallyInside(b, a)) {
-            indices.emplace_back(a->i);
-            indices.emplace_back(p->i);
-            indices.emplace_back(b->i);
+        if (!equals(a, b) && intersects(a, p, next(p), b) && locallyInside(a, b) && locallyInside(b, a)) {
+            indices.emplace_back(index(a));
+            indices.emplace_back(index(p));
+            indices.emplace_back(index(b));
 
             // remove two nodes involved
             removeNode(p);
-            removeNode(p->next);
+            removeNode(next(p));
 
             p = start = b;
         }
-        p = p->next;
+        p = next(p);
     } while (p != start);
 
     return filterPoints(p);
 }
 
 // try splitting polygon into two and triangulate them independently
-template <typename N>
-void Earcut<N>::splitEarcut(Node* start) {
+template <typename N, typename Layout>
+void Earcut<N, Layout>::splitEarcut(Ref start) {
     // look for a valid diagonal that divides the polygon into two
-    Node* a = start;
+    Ref a = start;
     do {
-        Node* b = a->next->next;
-        while (b != a->prev) {
-            if (a->i != b->i && isValidDiagonal(a, b)) {
+        Ref b = next(next(a));
+        while (b != prev(a)) {
+            if (index(a) != index(b) && isValidDiagonal(a, b)) {
                 // split the polygon in two by the diagonal
-                Node* c = splitPolygon(a, b);
+                Ref c = splitPolygon(a, b);
 
                 // filter colinear points around the cuts
-                a = filterPoints(a, a->next);
-                c = filterPoints(c, c->next);
+                a = filterPoints(a, next(a));
+                c = filterPoints(c, next(c));
 
                 // run earcut on each half
                 earcutLinked(a);
                 earcutLinked(c);
                 return;
             }
-            b = b->next;
+            b = next(b);
         }
-        a = a->next;
+        a = next(a);
     } while (a != start);
 }
 
 // link every hole into the outer loop, producing a single-ring polygon without holes
-template <typename N> template <typename Polygon>
-typename Earcut<N>::Node*
-Earcut<N>::eliminateHoles(const Polygon& points, Node* outerNode) {
+template <typename N, typename Layout> template <typename Polygon>
+typename Earcut<N, Layout>::Ref
+Earcut<N, Layout>::eliminateHoles(const Polygon& points, Ref outerNode) {
     const size_t len = points.size();
 
-    std::vector<Node*> queue;
+    std::vector<Ref> queue;
     for (size_t i = 1; i < len; i++) {
-        Node* list = linkedList(points[i], false);
+        Ref list = linkedList(points[i], false);
         if (list) {
-            if (list == list->next) list->steiner = true;
+            if (list == next(list)) steiner(list) = true;
             queue.push_back(getLeftmost(list));
         }
     }
-    std::sort(queue.begin(), queue.end(), [](const Node* a, const Node* b) {
-        return a->x < b->x;
+    std::sort(queue.begin(), queue.end(), [this](const Ref a, const Ref b) {
+        return x(a) < x(b);
     });
 
     // process holes from left to right
     for (size_t i = 0; i < queue.size(); i++) {
         eliminateHole(queue[i], outerNode);
-        outerNode = filterPoints(outerNode, outerNode->next);
+        outerNode = filterPoints(outerNode, next(outerNode));
     }
 
     return outerNode;
 }
 
 // find a bridge between vertices that connects hole with an outer ring and and link it
-template <typename N>
-void Earcut<N>::eliminateHole(Node* hole, Node* outerNode) {
+template <typename N, typename Layout>
+void Earcut<N, Layout>::eliminateHole(Ref hole, Ref outerNode) {
     outerNode = findHoleBridge(hole, outerNode);
     if (outerNode) {
-        Node* b = splitPolygon(outerNode, hole);
+        Ref b = splitPolygon(outerNode, hole);
 
         // filter out colinear points around cuts
-        filterPoints(outerNode, outerNode->next);
-        filterPoints(b, b->next);
+        filterPoints(outerNode, next(outerNode));
+        filterPoints(b, next(b));
     }
 }
 
 // David Eberly's algorithm for finding a bridge between hole and outer polygon
-template <typename N>
-typename Earcut<N>::Node*
-Earcut<N>::findHoleBridge(Node* hole, Node* outerNode) {
-    Node* p = outerNode;
-    double hx = hole->x;
-    double hy = hole->y;
+template <typename N, typename Layout>
+typename Earcut<N, Layout>::Ref
+Earcut<N, Layout>::findHoleBridge(Ref hole, Ref outerNode) {
+    Ref p = outerNode;
+    double hx = x(hole);
+    double hy = y(hole);
     double qx = -std::numeric_limits<double>::infinity();
-    Node* m = nullptr;
+    Ref m = Ref();
 
     // find a segment intersected by a ray from the hole's leftmost Vertex to the left;
     // segment's endpoint with lesser x will be potential connection Vertex
     do {
-        if (hy <= p->y && hy >= p->next->y && p->next->y != p->y) {
-          double x = p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
-          if (x <= hx && x > qx) {
-            qx = x;
-            if (x == hx) {
-                if (hy == p->y) return p;
-                if (hy == p->next->y) return p->next;
+        if (hy <= y(p) && hy >= y(next(p)) && y(next(p)) != y(p)) {
+          double ix = x(p) + (hy - y(p)) * (x(next(p)) - x(p)) / (y(next(p)) - y(p));
+          if (ix <= hx && ix > qx) {
+            qx = ix;
+            if (ix == hx) {
+                if (hy == y(p)) return p;
+                if (hy == y(next(p))) return next(p);
             }
-            m = p->x < p->next->x ? p : p->next;
+            m = x(p) < x(next(p)) ? p : next(p);
           }
         }
-        p = p->next;
+        p = next(p);
     } while (p != outerNode);
 
-    if (!m) return 0;
+    if (!m) return Ref();
 
     if (hx == qx) return m; // hole touches outer segment; pick leftmost endpoint
 
@@ -494,75 +616,75 @@ Earcut<N>::findHoleBridge(Node* hole, Node* outerNode) {
     // if there are no points found, we have a valid connection;
     // otherwise choose the Vertex of the minimum angle with the ray as connection Vertex
 
-    const Node* stop = m;
+    const Ref stop = m;
     double tanMin = std::numeric_limits<double>::infinity();
     double tanCur = 0;
 
     p = m;
-    double mx = m->x;
-    double my = m->y;
+    double mx = x(m);
+    double my = y(m);
 
     do {
-        if (hx >= p->x && p->x >= mx && hx != p->x &&
-            pointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, p->x, p->y)) {
+        if (hx >= x(p) && x(p) >= mx && hx != x(p) &&
+            pointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, x(p), y(p))) {
 
-            tanCur = std::abs(hy - p->y) / (hx - p->x); // tangential
+            tanCur = std::abs(hy - y(p)) / (hx - x(p)); // tangential
 
             if (locallyInside(p, hole) &&
-                (tanCur < tanMin || (tanCur == tanMin && (p->x > m->x || sectorContainsSector(m, p))))) {
+                (tanCur < tanMin || (tanCur == tanMin && (x(p) > x(m) || sectorContainsSector(m, p))))) {
                 m = p;
                 tanMin = tanCur;
             }
         }
 
-        p = p->next;
+        p = next(p);
     } while (p != stop);
 
     return m;
 }
 
 // whether sector in vertex m contains sector in vertex p in the same coordinates
-template <typename N>
-bool Earcut<N>::sectorContainsSector(const Node* m, const Node* p) {
-    return area(m->prev, m, p->prev) < 0 && area(p->next, m, m->next) < 0;
+template <typename N, typename Layout>
+bool Earcut<N, Layout>::sectorContainsSector(Ref m, Ref p) {
+    return area(prev(m), m, prev(p)) < 0 && area(next(p), m, next(m)) < 0;
 }
 
 // interlink polygon nodes in z-order
-template <typename N>
-void Earcut<N>::indexCurve(Node* start) {
+template <typename N, typename Layout>
+void Earcut<N, Layout>::indexCurve(Ref start) {
     assert(start);
-    Node* p = start;
+    Ref p = start;
 
     do {
-        p->z = p->z ? p->z : zOrder(p->x, p->y);
-        p->prevZ = p->prev;
-        p->nextZ = p->next;
-        p = p->next;
+        z(p) = z(p) ? z(p) : zOrder(x(p), y(p));
+        prevZ(p) = prev(p);
+        nextZ(p) = next(p);
+        p = next(p);
     } while (p != start);
 
-    p->prevZ->nextZ = nullptr;
-    p->prevZ = nullptr;
+    nextZ(prevZ(p)) = Ref();
+    prevZ(p) = Ref();
 
     sortLinked(p);
 }
 
 // Simon Tatham's linked list merge sort algorithm
 // http://www.chiark.greenend.org.uk/~sgtatham/algorithms/listsort.html
-template <typename N>
-typename Earcut<N>::Node*
-Earcut<N>::sortLinked(Node* list) {
+template <typename N, typename Layout>
+typename Earcut<N, Layout>::Ref
+Earcut<N, Layout>::sortLinked(Ref list) {
     assert(list);
-    Node* p;
-    Node* q;
-    Node* e;
-    Node* tail;
+    Ref p;
+    Ref q;
+    Ref e;
+    Ref tail;
     int i, numMerges, pSize, qSize;
     int inSize = 1;
 
     for (;;) {
         p = list;
-        list = nullptr;
-        tail = nullptr;
+        list = Ref();
+        tail = Ref();
         numMerges = 0;
 
         while (p) {
@@ -571,7 +693,7 @@ Earcut<N>::sortLinked(Node* list) {
             pSize = 0;
             for (i = 0; i < inSize; i++) {
                 pSize++;
-                q = q->nextZ;
+                q = nextZ(q);
                 if (!q) break;
             }
 
@@ -581,33 +703,33 @@ Earcut<N>::sortLinked(Node* list) {
 
                 if (pSize == 0) {
                     e = q;
-                    q = q->nextZ;
+                    q = nextZ(q);
                     qSize--;
                 } else if (qSize == 0 || !q) {
                     e = p;
-                    p = p->nextZ;
+                    p = nextZ(p);
                     pSize--;
-                } else if (p->z <= q->z) {
+                } else if (z(p) <= z(q)) {
                     e = p;
-                    p = p->nextZ;
+                    p = nextZ(p);
                     pSize--;
                 } else {
                     e = q;
-                    q = q->nextZ;
+                    q = nextZ(q);
                     qSize--;
                 }
 
-                if (tail) tail->nextZ = e;
+                if (tail) nextZ(tail) = e;
                 else list = e;
 
-                e->prevZ = tail;
+                prevZ(e) = tail;
                 tail = e;
             }
 
             p = q;
         }
 
-        tail->nextZ = nullptr;
+        nextZ(tail) = Ref();
 
         if (numMerges <= 1) return list;
 
@@ -616,8 +738,8 @@ Earcut<N>::sortLinked(Node* list) {
 }
 
 // z-order of a Vertex given coords and size of the data bounding box
-template <typename N>
-int32_t Earcut<N>::zOrder(const double x_, const double y_) {
+template <typename N, typename Layout>
+int32_t Earcut<N, Layout>::zOrder(const double x_, const double y_) {
     // coords are transformed into non-negative 15-bit integer range
     int32_t x = static_cast<int32_t>(32767.0 * (x_ - minX) * inv_size);
     int32_t y = static_cast<int32_t>(32767.0 * (y_ - minY) * inv_size);
@@ -636,52 +758,52 @@ int32_t Earcut<N>::zOrder(const double x_, const double y_) {
 }
 
 // find the leftmost node of a polygon ring
-template <typename N>
-typename Earcut<N>::Node*
-Earcut<N>::getLeftmost(Node* start) {
-    Node* p = start;
-    Node* leftmost = start;
+template <typename N, typename Layout>
+typename Earcut<N, Layout>::Ref
+Earcut<N, Layout>::getLeftmost(Ref start) {
+    Ref p = start;
+    Ref leftmost = start;
     do {
-        if (p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y))
+        if (x(p) < x(leftmost) || (x(p) == x(leftmost) && y(p) < y(leftmost)))
             leftmost = p;
-        p = p->next;
+        p = next(p);
     } while (p != start);
 
     return leftmost;
 }
 
 // check if a point lies within a convex triangle
-template <typename N>
-bool Earcut<N>::pointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py) const {
+template <typename N, typename Layout>
+bool Earcut<N, Layout>::pointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py) const {
     return (cx - px) * (ay - py) - (ax - px) * (cy - py) >= 0 &&
            (ax - px) * (by - py) - (bx - px) * (ay - py) >= 0 &&
            (bx - px) * (cy - py) - (cx - px) * (by - py) >= 0;
 }
 
 // check if a diagonal between two polygon nodes is valid (lies in polygon interior)
-template <typename N>
-bool Earcut<N>::isValidDiagonal(Node* a, Node* b) {
-    return a->next->i != b->i && a->prev->i != b->i && !intersectsPolygon(a, b) && // dones't intersect other edges
+template <typename N, typename Layout>
+bool Earcut<N, Layout>::isValidDiagonal(Ref a, Ref b) {
+    return index(next(a)) != index(b) && index(prev(a)) != index(b) && !intersectsPolygon(a, b) && // dones't intersect other edges
            ((locallyInside(a, b) && locallyInside(b, a) && middleInside(a, b) && // locally visible
-            (area(a->prev, a, b->prev) != 0.0 || area(a, b->prev, b) != 0.0)) || // does not create opposite-facing sectors
-            (equals(a, b) && area(a->prev, a, a->next) > 0 && area(b->prev, b, b->next) > 0)); // special zero-length case
+            (area(prev(a), a, prev(b)) != 0.0 || area(a, prev(b), b) != 0.0)) || // does not create opposite-facing sectors
+            (equals(a, b) && area(prev(a), a, next(a)) > 0 && area(prev(b), b, next(b)) > 0)); // special zero-length case
 }
 
 // signed area of a triangle
-template <typename N>
-double Earcut<N>::area(const Node* p, const Node* q, const Node* r) const {
-    return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+template <typename N, typename Layout>
+double Earcut<N, Layout>::area(Ref p, Ref q, Ref r) const {
+    return (y(q) - y(p)) * (x(r) - x(q)) - (x(q) - x(p)) * (y(r) - y(q));
 }
 
 // check if two points are equal
-template <typename N>
-bool Earcut<N>::equals(const Node* p1, const Node* p2) {
-    return p1->x == p2->x && p1->y == p2->y;
+template <typename N, typename Layout>
+bool Earcut<N, Layout>::equals(Ref p1, Ref p2) {
+    return x(p1) == x(p2) && y(p1) == y(p2);
 }
 
 // check if two segments intersect
-template <typename N>
-bool Earcut<N>::intersects(const Node* p1, const Node* q1, const Node* p2, const Node* q2) {
+template <typename N, typename Layout>
+bool Earcut<N, Layout>::intersects(Ref p1, Ref q1, Ref p2, Ref q2) {
     int o1 = sign(area(p1, q1, p2));
     int o2 = sign(area(p1, q1, q2));
     int o3 = sign(area(p2, q2, p1));
@@ -698,52 +820,52 @@ bool Earcut<N>::intersects(const Node* p1, const Node* q1, const Node* p2, const
 }
 
 // for collinear points p, q, r, check if point q lies on segment pr
-template <typename N>
-bool Earcut<N>::onSegment(const Node* p, const Node* q, const Node* r) {
-    return q->x <= std::max<double>(p->x, r->x) &&
-        q->x >= std::min<double>(p->x, r->x) &&
-        q->y <= std::max<double>(p->y, r->y) &&
-        q->y >= std::min<double>(p->y, r->y);
+template <typename N, typename Layout>
+bool Earcut<N, Layout>::onSegment(Ref p, Ref q, Ref r) {
+    return x(q) <= std::max<double>(x(p), x(r)) &&
+        x(q) >= std::min<double>(x(p), x(r)) &&
+        y(q) <= std::max<double>(y(p), y(r)) &&
+        y(q) >= std::min<double>(y(p), y(r));
 }
 
-template <typename N>
-int Earcut<N>::sign(double val) {
+template <typename N, typename Layout>
+int Earcut<N, Layout>::sign(double val) {
     return (0.0 < val) - (val < 0.0);
 }
 
 // check if a polygon diagonal intersects any polygon segments
-template <typename N>
-bool Earcut<N>::intersectsPolygon(const Node* a, const Node* b) {
-    const Node* p = a;
+template <typename N, typename Layout>
+bool Earcut<N, Layout>::intersectsPolygon(Ref a, Ref b) {
+    Ref p = a;
     do {
-        if (p->i != a->i && p->next->i != a->i && p->i != b->i && p->next->i != b->i &&
-                intersects(p, p->next, a, b)) return true;
-        p = p->next;
+        if (index(p) != index(a) && index(next(p)) != index(a) && index(p) != index(b) && index(next(p)) != index(b) &&
+                intersects(p, next(p), a, b)) return true;
+        p = next(p);
     } while (p != a);
 
     return false;
 }
 
 // check if a polygon diagonal is locally inside the polygon
-template <typename N>
-bool Earcut<N>::locallyInside(const Node* a, const Node* b) {
-    return area(a->prev, a, a->next) < 0 ?
-        area(a, b, a->next) >= 0 && area(a, a->prev, b) >= 0 :
-        area(a, b, a->prev) < 0 || area(a, a->next, b) < 0;
+template <typename N, typename Layout>
+bool Earcut<N, Layout>::locallyInside(Ref a, Ref b) {
+    return area(prev(a), a, next(a)) < 0 ?
+        area(a, b, next(a)) >= 0 && area(a, prev(a), b) >= 0 :
+        area(a, b, prev(a)) < 0 || area(a, next(a), b) < 0;
 }
 
 // check if the middle Vertex of a polygon diagonal is inside the polygon
-template <typename N>
-bool Earcut<N>::middleInside(const Node* a, const Node* b) {
-    const Node* p = a;
+template <typename N, typename Layout>
+bool Earcut<N, Layout>::middleInside(Ref a, Ref b) {
+    Ref p = a;
     bool inside = false;
-    double px = (a->x + b->x) / 2;
-    double py = (a->y + b->y) / 2;
+    double px = (x(a) + x(b)) / 2;
+    double py = (y(a) + y(b)) / 2;
     do {
-        if (((p->y > py) != (p->next->y > py)) && p->next->y != p->y &&
-                (px < (p->next->x - p->x) * (py - p->y) / (p->next->y - p->y) + p->x))
+        if (((y(p) > py) != (y(next(p)) > py)) && y(next(p)) != y(p) &&
+                (px < (x(next(p)) - x(p)) * (py - y(p)) / (y(next(p)) - y(p)) + x(p)))
             inside = !inside;
-        p = p->next;
+        p = next(p);
     } while (p != a);
 
     return inside;
@@ -752,64 +874,64 @@ bool Earcut<N>::middleInside(const Node* a, const Node* b) {
 // link two polygon vertices with a bridge; if the vertices belong to the same ring, it splits
 // polygon into two; if one belongs to the outer ring and another to a hole, it merges it into a
 // single ring
-template <typename N>
-typename Earcut<N>::Node*
-Earcut<N>::splitPolygon(Node* a, Node* b) {
-    Node* a2 = nodes.construct(a->i, a->x, a->y);
-    Node* b2 = nodes.construct(b->i, b->x, b->y);
-    Node* an = a->next;
-    Node* bp = b->prev;
+template <typename N, typename Layout>
+typename Earcut<N, Layout>::Ref
+Earcut<N, Layout>::splitPolygon(Ref a, Ref b) {
+    typedef typename Nodes::Coord Coord;
+    Ref a2 = nodes().construct(index(a), static_cast<Coord>(x(a)), static_cast<Coord>(y(a)));
+    Ref b2 = nodes().construct(index(b), static_cast<Coord>(x(b)), static_cast<Coord>(y(b)));
+    Ref an = next(a);
+    Ref bp = prev(b);
 
-    a->next = b;
-    b->prev = a;
+    next(a) = b;
+    prev(b) = a;
 
-    a2->next = an;
-    an->prev = a2;
+    next(a2) = an;
+    prev(an) = a2;
 
-    b2->next = a2;
-    a2->prev = b2;
+    next(b2) = a2;
+    prev(a2) = b2;
 
-    bp->next = b2;
-    b2->prev = bp;
+    next(bp) = b2;
+    prev(b2) = bp;
 
     return b2;
 }
 
 // create a node and util::optionally link it with previous one (in a circular doubly linked list)
-template <typename N> template <typename Point>
-typename Earcut<N>::Node*
-Earcut<N>::insertNode(std::size_t i, const Point& pt, Node* last) {
-    Node* p = nodes.construct(static_cast<N>(i), util::nth<0, Point>::get(pt), util::nth<1, Point>::get(pt));
+template <typename N, typename Layout> template <typename Point>
+typename Earcut<N, Layout>::Ref
+Earcut<N, Layout>::insertNode(std::size_t i, const Point& pt, Ref last) {
+    Ref p = nodes().construct(static_cast<N>(i), util::nth<0, Point>::get(pt), util::nth<1, Point>::get(pt));
 
     if (!last) {
-        p->prev = p;
-        p->next = p;
+        prev(p) = p;
+        next(p) = p;
 
     } else {
         assert(last);
-        p->next = last->next;
-        p->prev = last;
-        last->next->prev = p;
-        last->next = p;
+        next(p) = next(last);
+        prev(p) = last;
+        prev(next(last)) = p;
+        next(last) = p;
     }
     return p;
 }
 
-template <typename N>
-void Earcut<N>::removeNode(Node* p) {
-    p->next->prev = p->prev;
-    p->prev->next = p->next;
+template <typename N, typename Layout>
+void Earcut<N, Layout>::removeNode(Ref p) {
+    next(prev(p)) = next(p);
+    prev(next(p)) = prev(p);
 
-    if (p->prevZ) p->prevZ->nextZ = p->nextZ;
-    if (p->nextZ) p->nextZ->prevZ = p->prevZ;
+    if (prevZ(p)) nextZ(prevZ(p)) = nextZ(p);
+    if (nextZ(p)) prevZ(nextZ(p)) = prevZ(p);
 }
 }
 
-template <typename N = uint32_t, typename Polygon>
+template <typename N = uint32_t, typename Layout = PointerLayout, typename Polygon>
 std::vector<N> earcut(const Polygon& poly) {
-    mapbox::detail::Earcut<N> earcut;
+    mapbox::detail::Earcut<N, Layout> earcut;
     earcut(poly);
     return std::move(earcut.indices);
 }
 }
-
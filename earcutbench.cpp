@@ -0,0 +1,92 @@
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#include "reader.hpp"
+#include "triangulate.hpp"
+
+// Triangulates a polygon (the first one of a text file, or a generated ring)
+// with earcut, reading the coordinates through the old int64_t adaptor or the
+// Scalar one, into pointer nodes or the indexed PointLayout. The generated
+// ring is a wave with vertices about a unit apart, jittered by less than
+// that, unless -r sets its radius; much finer rings collapse under the
+// int64_t adaptor, and earcut crawls through the duplicates.
+
+// a Point read the way the adaptor used to, rounded toward zero
+struct IntPoint {
+    Scalar x, y;
+};
+
+namespace mapbox {
+namespace util {
+template <> struct nth<0, IntPoint> {
+    static int64_t get(const IntPoint &t) { return t.x; };
+};
+
+template <> struct nth<1, IntPoint> {
+    static int64_t get(const IntPoint &t) { return t.y; };
+};
+} // namespace util
+} // namespace mapbox
+
+static Polygon makeRing(size_t n, double radius, mt19937 &rng) {
+    uniform_real_distribution<Scalar> jitter(-0.4f, 0.4f);
+    Polygon poly;
+    for (size_t i = 0; i < n; ++i) {
+        double a = 2 * PI * i / n;
+        double r = radius * (1 + 0.3 * sin(a * 17)) + jitter(rng);
+        poly.push_back(Point(r * cos(a), r * sin(a)));
+    }
+    return poly;
+}
+
+static double seconds(chrono::steady_clock::time_point since) {
+    return chrono::duration<double>(chrono::steady_clock::now() - since).count();
+}
+
+template <class Layout, class Ring>
+static void run(const char *adaptor, const char *layout, const Ring &ring) {
+    vector<Ring> rings{ring};
+    auto start = chrono::steady_clock::now();
+    vector<uint32_t> indices = mapbox::earcut<uint32_t, Layout>(rings);
+    double elapsed = seconds(start);
+    printf("%-7s %-16s %7.3f s  %zu triangles\n", adaptor, layout, elapsed, indices.size() / 3);
+}
+
+int main(int argc, char **argv) {
+    size_t vertices = 1000000;
+    double radius = 0;
+    const char *path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            vertices = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            radius = atof(argv[++i]);
+        } else {
+            path = argv[i];
+        }
+    }
+
+    mt19937 rng(1);
+    Polygon poly;
+    if (path) {
+        PolygonReader reader(path);
+        if (!reader.next(poly)) {
+            fprintf(stderr, "%s\n", reader.ok() ? "no polygon" : reader.error().c_str());
+            return 1;
+        }
+    } else {
+        poly = makeRing(vertices, radius > 0 ? radius : vertices / (2 * PI), rng);
+    }
+    vector<IntPoint> rounded(poly.size());
+    for (size_t i = 0; i < poly.size(); ++i) {
+        rounded[i] = {poly[i].x, poly[i].y};
+    }
+
+    printf("%zu vertices, %zu triangles expected\n", poly.size(), poly.size() - 2);
+    run<mapbox::PointerLayout>("int64", "pointer", rounded);
+    run<mapbox::IndexedLayout<double>>("int64", "indexed double", rounded);
+    run<mapbox::PointerLayout>("Scalar", "pointer", poly);
+    run<PointLayout>("Scalar", "PointLayout", poly);
+    return 0;
+}
@@ -0,0 +1,298 @@
+#include "engine.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "merge.hpp"
+#include "triangulate.hpp"
+
+void decomposeRings(const Rings &rings, Decomposition &out, DecompositionCache *cache,
+                    const CancelToken *token) {
+    if (rings.empty()) {
+        return;
+    }
+    if (rings.size() == 1) {
+        if (cache) {
+            cache->decompose(rings[0], out, token);
+        } else {
+            decomposePoly(rings[0], out, token);
+        }
+        return;
+    }
+    triangulateRings(rings, out);
+}
+
+void triangulateRings(const Rings &rings, Decomposition &out) {
+    vector<Point> verts;
+    for (const Polygon &ring : rings) {
+        verts.insert(verts.end(), ring.begin(), ring.end());
+    }
+    uint32_t firstPiece = out.pieces();
+    vector<uint32_t> indices = mapbox::earcut<uint32_t, PointLayout>(rings);
+    vector<vector<uint32_t>> pieces;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        pieces.push_back({indices[i], indices[i + 1], indices[i + 2]});
+        if (!left(verts[indices[i]], verts[indices[i + 1]], verts[indices[i + 2]])) {
+            swap(pieces.back()[1], pieces.back()[2]);
+        }
+    }
+    if (out.output & Decomposition::Merged) {
+        out.merged += mergeNeighbors(pieces, [&](uint32_t id) { return verts[id]; },
+                                     [](uint32_t, uint32_t) { return true; }, true);
+        pieces.erase(remove_if(pieces.begin(), pieces.end(),
+                               [](const vector<uint32_t> &piece) { return piece.empty(); }),
+                     pieces.end());
+    }
+    for (const vector<uint32_t> &piece : pieces) {
+        if (out.output & Decomposition::Indices) {
+            if (out.firstIndex.empty()) {
+                out.firstIndex.push_back(0);
+            }
+            out.indices.insert(out.indices.end(), piece.begin(), piece.end());
+            out.firstIndex.push_back(out.indices.size());
+        }
+        if (out.wantsPolygons()) {
+            Polygon poly;
+            for (uint32_t id : piece) {
+                poly.push_back(verts[id]);
+            }
+            out.addPolygon(poly);
+        }
+    }
+    if (!(out.output & Decomposition::Adjacency)) {
+        return;
+    }
+
+    // pieces sharing an edge run it in opposite directions
+    unordered_map<uint64_t, uint32_t> edges;
+    for (uint32_t p = 0; p < pieces.size(); ++p) {
+        for (size_t k = 0; k < pieces[p].size(); ++k) {
+            edges[uint64_t(pieces[p][k]) << 32 | pieces[p][(k + 1) % pieces[p].size()]] = p;
+        }
+    }
+    if (out.firstNeighbor.empty()) {
+        out.firstNeighbor.push_back(0);
+    }
+    out.firstNeighbor.resize(firstPiece + 1, out.neighbors.size());
+    for (const vector<uint32_t> &piece : pieces) {
+        for (size_t k = 0; k < piece.size(); ++k) {
+            uint32_t a = piece[k], b = piece[(k + 1) % piece.size()];
+            auto it = edges.find(uint64_t(b) << 32 | a);
+            if (it != edges.end()) {
+                out.neighbors.push_back({firstPiece + it->second, verts[a], verts[b]});
+            }
+        }
+        out.firstNeighbor.push_back(out.neighbors.size());
+    }
+}
+
+Engine::Engine(unsigned threads) {
+    if (threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back(&Engine::work, this);
+    }
+}
+
+Engine::~Engine() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread &t : workers) {
+        t.join();
+    }
+}
+
+void Engine::run(function<void()> task, Priority priority) {
+    {
+        lock_guard<mutex> guard(lock);
+        tasks[int(priority)].push_back(move(task));
+    }
+    wake.notify_one();
+}
+
+void Engine::work() {
+    for (;;) {
+        function<void()> task;
+        {
+            unique_lock<mutex> guard(lock);
+            deque<function<void()>> *queue = nullptr;
+            wake.wait(guard, [&] {
+                for (int p = int(Priority::Interactive); p >= 0 && !queue; --p) {
+                    if (!tasks[p].empty()) {
+                        queue = &tasks[p];
+                    }
+                }
+                return stopping || queue;
+            });
+            if (!queue) {
+                return;
+            }
+            task = move(queue->front());
+            queue->pop_front();
+        }
+        task();
+    }
+}
+
+void Engine::parallelFor(size_t count, const function<void(size_t, size_t)> &body,
+                         Priority priority) {
+    if (count == 0) {
+        return;
+    }
+
+    // a few chunks per worker even out items of very different cost
+    size_t chunk = count / (workers.size() * 4) + 1;
+    size_t remaining = (count + chunk - 1) / chunk;
+    mutex doneLock;
+    condition_variable done;
+
+    for (size_t first = 0; first < count; first += chunk) {
+        size_t last = min(first + chunk, count);
+        run([&, first, last] {
+            body(first, last);
+            lock_guard<mutex> guard(doneLock);
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        }, priority);
+    }
+
+    unique_lock<mutex> guard(doneLock);
+    done.wait(guard, [&] { return remaining == 0; });
+}
+
+void Engine::decompose(const vector<Rings> &batch, vector<Decomposition> &out, int output,
+                       Priority priority) {
+    out.resize(batch.size());
+    parallelFor(batch.size(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            CancelToken token;
+            limit(token);
+            out[i].clear();
+            out[i].output = output;
+            decomposeOne(batch[i], out[i], &token);
+        }
+    }, priority);
+}
+
+void Engine::decomposeOne(const Rings &rings, Decomposition &out, const CancelToken *token) {
+    if (routing) {
+        Algorithm algorithm = decomposeAuto(rings, out, *routing, cache, token);
+        routeCounts[int(algorithm)].fetch_add(1, memory_order_relaxed);
+    } else {
+        decomposeRings(rings, out, cache, token);
+    }
+}
+
+// starts the per-polygon time limit, if any, on the token
+void Engine::limit(CancelToken &token) const {
+    token.fallback = fallback;
+    if (timeLimit.count() > 0) {
+        token.setDeadline(chrono::steady_clock::now() + timeLimit);
+    }
+}
+
+struct DecompositionFuture::State {
+    enum Stage { Queued, Running, Done, Cancelled };
+
+    Rings rings;
+    Decomposition result;
+    CancelToken token;
+    Stage stage = Queued;
+    mutex lock;
+    condition_variable finished;
+};
+
+DecompositionFuture Engine::submit(Rings &rings, int output, Priority priority,
+                                   function<void(const Polygon &piece)> sink) {
+    DecompositionFuture future;
+    shared_ptr<DecompositionFuture::State> job = make_shared<DecompositionFuture::State>();
+    job->rings.swap(rings);
+    job->result.output = output;
+    job->result.sink = move(sink);
+    run([this, job] {
+        typedef DecompositionFuture::State State;
+        {
+            lock_guard<mutex> guard(job->lock);
+            if (job->stage == State::Cancelled) {
+                return;
+            }
+            job->stage = State::Running;
+        }
+        limit(job->token);
+        decomposeOne(job->rings, job->result, &job->token);
+        lock_guard<mutex> guard(job->lock);
+        job->stage = State::Done;
+        job->finished.notify_all();
+    }, priority);
+    future.job = move(job);
+    return future;
+}
+
+bool DecompositionFuture::ready() const {
+    lock_guard<mutex> guard(job->lock);
+    return job->stage == State::Done || job->stage == State::Cancelled;
+}
+
+bool DecompositionFuture::wait() const {
+    unique_lock<mutex> guard(job->lock);
+    job->finished.wait(guard, [this] {
+        return job->stage == State::Done || job->stage == State::Cancelled;
+    });
+    return job->stage == State::Done;
+}
+
+bool DecompositionFuture::waitFor(chrono::microseconds timeout) const {
+    unique_lock<mutex> guard(job->lock);
+    job->finished.wait_for(guard, timeout, [this] {
+        return job->stage == State::Done || job->stage == State::Cancelled;
+    });
+    return job->stage == State::Done;
+}
+
+Decomposition DecompositionFuture::get() {
+    wait();
+    lock_guard<mutex> guard(job->lock);
+    return move(job->result);
+}
+
+bool DecompositionFuture::cancel() {
+    lock_guard<mutex> guard(job->lock);
+    if (job->stage == State::Queued) {
+        job->stage = State::Cancelled;
+        // the queued task finds the job cancelled and skips it
+        job->rings.clear();
+        job->finished.notify_all();
+    } else if (job->stage == State::Running) {
+        job->token.cancel();
+    }
+    return job->stage != State::Done;
+}
+
+BatchStream::BatchStream(Engine &engine, Sink sink, size_t batchSize, int output)
+    : engine(engine), sink(move(sink)), batchSize(max(batchSize, size_t(1))), output(output) {
+}
+
+void BatchStream::push(Rings &rings) {
+    batch.emplace_back();
+    batch.back().swap(rings);
+    ++count;
+    if (batch.size() >= batchSize) {
+        flush();
+    }
+}
+
+void BatchStream::flush() {
+    if (batch.empty()) {
+        return;
+    }
+    engine.decompose(batch, results, output, Priority::Bulk);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        sink(batch[i], results[i]);
+    }
+    batch.clear();
+}
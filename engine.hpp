@@ -0,0 +1,146 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "cache.hpp"
+#include "decomp.hpp"
+#include "dispatch.hpp"
+
+// Decomposes a polygon given as rings. A bare outline goes through Bayazit's
+// decomposition; polygons with holes are split into earcut triangles, which
+// are convex pieces as well. Indices address the rings one after another.
+// Outlines go through the cache when one is given, and stop early when the
+// token fires (earcut already bounds the work for polygons with holes).
+void decomposeRings(const Rings &rings, Decomposition &out,
+                    DecompositionCache *cache = nullptr, const CancelToken *token = nullptr);
+
+// The earcut triangles of a polygon, with or without holes, as pieces.
+void triangulateRings(const Rings &rings, Decomposition &out);
+
+// Order in which workers pick up queued work: interactive jobs go ahead of
+// everything queued, bulk jobs run when nothing else waits. Work that has
+// started is never interrupted.
+enum class Priority { Bulk, Normal, Interactive };
+
+// Handle to a polygon decomposing in the background (see Engine::submit).
+class DecompositionFuture {
+public:
+    bool valid() const { return job != nullptr; }
+    // finished or cancelled, never blocks
+    bool ready() const;
+    // blocks until the job is done, false if it was cancelled
+    bool wait() const;
+    // false if the job is not done by then or was cancelled
+    bool waitFor(chrono::microseconds timeout) const;
+    // moves the result out once wait() returned true
+    Decomposition get();
+    // Drops the job if it is still queued, or stops a running one at its
+    // next split with a truncated result. True unless the job was done.
+    bool cancel();
+
+private:
+    friend class Engine;
+    struct State;
+    shared_ptr<State> job;
+};
+
+// Fixed pool of worker threads that decomposes batches of polygons.
+class Engine {
+public:
+    // 0 threads means one per hardware thread
+    Engine(unsigned threads = 0);
+    ~Engine();
+
+    Engine(const Engine &) = delete;
+    Engine &operator=(const Engine &) = delete;
+
+    unsigned threads() const { return workers.size(); }
+
+    // optional cache shared by all workers, not owned
+    void setCache(DecompositionCache *cache) { this->cache = cache; }
+
+    // Sends every polygon down the route the policy picks (see
+    // decomposeAuto) instead of decomposeRings; not owned, null turns
+    // routing off. routed() counts the polygons that took each path.
+    void setRouting(const RoutingPolicy *policy) { routing = policy; }
+    uint64_t routed(Algorithm algorithm) const {
+        return routeCounts[int(algorithm)].load(memory_order_relaxed);
+    }
+
+    // Bounds the time spent on each polygon from the moment a worker picks
+    // it up; polygons over the limit come out truncated (see CancelToken).
+    // Zero, the default, means no limit.
+    void setTimeLimit(chrono::microseconds limit,
+                      CancelToken::Fallback fallback = CancelToken::Triangulate) {
+        timeLimit = limit;
+        this->fallback = fallback;
+    }
+
+    // Decomposes every polygon of the batch, out[i] receives the pieces of
+    // batch[i] in the representations given by output (see Decomposition).
+    // Blocks until the whole batch is done.
+    void decompose(const vector<Rings> &batch, vector<Decomposition> &out,
+                   int output = Decomposition::Polygons, Priority priority = Priority::Normal);
+
+    // Queues one polygon and returns at once; takes the rings over, leaving
+    // them empty. The sink, if any, gets the pieces on the worker thread as
+    // they are found (an SpscQueue carries them on to another thread).
+    DecompositionFuture submit(Rings &rings, int output = Decomposition::Polygons,
+                               Priority priority = Priority::Normal,
+                               function<void(const Polygon &piece)> sink = nullptr);
+
+    // Runs body(first, last) over chunks of [0, count) on the pool and waits
+    // for all of them.
+    void parallelFor(size_t count, const function<void(size_t, size_t)> &body,
+                     Priority priority = Priority::Normal);
+
+private:
+    vector<thread> workers;
+    deque<function<void()>> tasks[3]; // by priority
+    mutex lock;
+    condition_variable wake;
+    bool stopping = false;
+    DecompositionCache *cache = nullptr;
+    const RoutingPolicy *routing = nullptr;
+    atomic<uint64_t> routeCounts[4] = {};
+    chrono::microseconds timeLimit{0};
+    CancelToken::Fallback fallback = CancelToken::Triangulate;
+
+    void limit(CancelToken &token) const;
+    void decomposeOne(const Rings &rings, Decomposition &out, const CancelToken *token);
+    void run(function<void()> task, Priority priority);
+    void work();
+};
+
+// Collects polygons from a stream into batches of a fixed size and hands
+// every result, in the representations given by output, to a sink in input
+// order, so inputs of any length are decomposed with memory for only one
+// batch. Batches run at bulk priority.
+class BatchStream {
+public:
+    typedef function<void(const Rings &input, const Decomposition &result)> Sink;
+
+    BatchStream(Engine &engine, Sink sink, size_t batchSize = 4096,
+                int output = Decomposition::Polygons);
+    ~BatchStream() { flush(); }
+
+    // takes the rings over, leaving them empty
+    void push(Rings &rings);
+    void flush();
+
+    size_t polygons() const { return count; }
+
+private:
+    Engine &engine;
+    Sink sink;
+    size_t batchSize, count = 0;
+    int output;
+    vector<Rings> batch;
+    vector<Decomposition> results;
+};
@@ -0,0 +1,558 @@
+#include "gis.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+
+#include "mapped.hpp"
+#include "reader.hpp"
+
+namespace {
+
+// Nested arrays and objects deeper than this are rejected instead of
+// recursing without bound on hostile input.
+const int maxDepth = 256;
+
+// Shared tokenizer state of both readers.
+class Scanner {
+public:
+    Scanner(MappedFile &file, const PolygonCallback &callback)
+        : file(file), callback(callback), begin(file.data()), cur(begin), end(file.end()) {}
+
+    const string &error() const { return err; }
+
+protected:
+    MappedFile &file;
+    const PolygonCallback &callback;
+    const char *begin, *cur, *end;
+    string err;
+    // index of the feature being read
+    size_t feature = 0;
+
+    bool fail(const string &what) {
+        if (err.empty()) {
+            err = "line " + to_string(count(begin, cur, '\n') + 1) + ": " + what;
+        }
+        return false;
+    }
+
+    void skipSpace() {
+        while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\n' || *cur == '\r')) {
+            ++cur;
+        }
+    }
+
+    bool accept(char c) {
+        skipSpace();
+        if (cur < end && *cur == c) {
+            ++cur;
+            return true;
+        }
+        return false;
+    }
+
+    bool expect(char c) { return accept(c) || fail(string("expected '") + c + "'"); }
+
+    bool number(Scalar &v) {
+        skipSpace();
+        const char *p = parseScalar(cur, end, v);
+        if (!p) {
+            return fail("expected a number");
+        }
+        cur = p;
+        return true;
+    }
+
+    static void closeRing(Polygon &ring) {
+        if (ring.size() > 1 && ring.front().x == ring.back().x &&
+            ring.front().y == ring.back().y) {
+            ring.pop_back();
+        }
+    }
+
+    // hands a polygon to the callback unless it has no outline
+    void emit(Rings &rings) {
+        if (!rings.empty() && !rings[0].empty()) {
+            callback(rings, feature);
+        }
+        file.release(cur);
+    }
+};
+
+class WKTParser : public Scanner {
+public:
+    using Scanner::Scanner;
+
+    bool parse() {
+        for (;;) {
+            skipSpace();
+            if (cur == end) {
+                return true;
+            }
+            if (!geometry(0)) {
+                return false;
+            }
+            accept(';');
+            ++feature;
+        }
+    }
+
+private:
+    Rings rings;
+
+    bool word(string &w) {
+        skipSpace();
+        w.clear();
+        for (; cur < end && isalpha(static_cast<unsigned char>(*cur)); ++cur) {
+            w += toupper(static_cast<unsigned char>(*cur));
+        }
+        return !w.empty();
+    }
+
+    bool geometry(int depth) {
+        if (depth > maxDepth) {
+            return fail("geometry nested too deeply");
+        }
+        string type, w;
+        if (!word(type)) {
+            return fail("expected a geometry type");
+        }
+        if (type == "SRID") {
+            cur = find(cur, end, ';');
+            cur += cur < end;
+            return geometry(depth);
+        }
+        for (skipSpace(); cur < end && isalpha(static_cast<unsigned char>(*cur)); skipSpace()) {
+            word(w);
+            if (w == "EMPTY") {
+                return true;
+            }
+            if (w != "Z" && w != "M" && w != "ZM") {
+                return fail("unexpected '" + w + "'");
+            }
+        }
+
+        if (type == "POLYGON") {
+            if (!polygon()) {
+                return false;
+            }
+            emit(rings);
+            return true;
+        }
+        if (type == "MULTIPOLYGON") {
+            if (!expect('(')) {
+                return false;
+            }
+            do {
+                if (!polygon()) {
+                    return false;
+                }
+                emit(rings);
+            } while (accept(','));
+            return expect(')');
+        }
+        if (type == "GEOMETRYCOLLECTION") {
+            if (!expect('(')) {
+                return false;
+            }
+            do {
+                if (!geometry(depth + 1)) {
+                    return false;
+                }
+            } while (accept(','));
+            return expect(')');
+        }
+        return skipParens();
+    }
+
+    // skips the coordinates of a geometry type without polygons
+    bool skipParens() {
+        if (!expect('(')) {
+            return false;
+        }
+        for (int open = 1; open > 0; ++cur) {
+            if (cur == end) {
+                return fail("unbalanced '('");
+            }
+            open += (*cur == '(') - (*cur == ')');
+        }
+        return true;
+    }
+
+    bool polygon() {
+        skipSpace();
+        if (cur < end && isalpha(static_cast<unsigned char>(*cur))) {
+            string w;
+            word(w);
+            rings.clear();
+            return w == "EMPTY" || fail("unexpected '" + w + "'");
+        }
+        if (!expect('(')) {
+            return false;
+        }
+        size_t n = 0;
+        do {
+            if (n == rings.size()) {
+                rings.emplace_back();
+            }
+            if (!ring(rings[n++])) {
+                return false;
+            }
+        } while (accept(','));
+        rings.resize(n);
+        return expect(')');
+    }
+
+    bool ring(Polygon &ring) {
+        ring.clear();
+        if (!expect('(')) {
+            return false;
+        }
+        Point p;
+        Scalar ignored;
+        do {
+            if (!number(p.x) || !number(p.y)) {
+                return false;
+            }
+            for (skipSpace(); cur < end && *cur != ',' && *cur != ')'; skipSpace()) {
+                if (!number(ignored)) {
+                    return false;
+                }
+            }
+            ring.push_back(p);
+        } while (accept(','));
+        closeRing(ring);
+        return expect(')');
+    }
+};
+
+class GeoJSONParser : public Scanner {
+public:
+    using Scanner::Scanner;
+
+    bool parse() {
+        if (!value(0)) {
+            return false;
+        }
+        skipSpace();
+        return cur == end || fail("trailing data");
+    }
+
+private:
+    // polygons of the last coordinates array, reused between geometries
+    vector<Rings> polys;
+    size_t polyCount = 0;
+
+    bool value(int depth) {
+        if (depth > maxDepth) {
+            return fail("document nested too deeply");
+        }
+        skipSpace();
+        if (cur == end) {
+            return fail("unexpected end of input");
+        }
+        switch (*cur) {
+        case '{':
+            return object(depth);
+        case '[':
+            return array(depth);
+        case '"':
+            return text(nullptr);
+        }
+        // numbers and literals are not needed, only skipped
+        const char *start = cur;
+        while (cur < end && (isalnum(static_cast<unsigned char>(*cur)) || *cur == '-' ||
+                             *cur == '+' || *cur == '.')) {
+            ++cur;
+        }
+        return cur != start || fail("unexpected character");
+    }
+
+    bool text(string *out) {
+        if (!expect('"')) {
+            return false;
+        }
+        const char *start = cur;
+        for (; cur < end && *cur != '"'; ++cur) {
+            cur += *cur == '\\';
+        }
+        if (cur >= end) {
+            return fail("unterminated string");
+        }
+        if (out) {
+            out->assign(start, cur);
+        }
+        ++cur;
+        return true;
+    }
+
+    bool array(int depth) {
+        if (!expect('[')) {
+            return false;
+        }
+        if (accept(']')) {
+            return true;
+        }
+        do {
+            if (!value(depth + 1)) {
+                return false;
+            }
+        } while (accept(','));
+        return expect(']');
+    }
+
+    bool object(int depth) {
+        if (!expect('{')) {
+            return false;
+        }
+        string key, type;
+        int coordDepth = 0;
+        if (!accept('}')) {
+            do {
+                skipSpace();
+                if (!text(&key) || !expect(':')) {
+                    return false;
+                }
+                skipSpace();
+                bool ok;
+                if (key == "type" && cur < end && *cur == '"') {
+                    ok = text(&type);
+                } else if (key == "coordinates") {
+                    ok = coordinates(depth + 1, coordDepth);
+                } else if (key == "features" && depth == 0) {
+                    ok = features(depth + 1);
+                } else {
+                    ok = value(depth + 1);
+                }
+                if (!ok) {
+                    return false;
+                }
+            } while (accept(','));
+            if (!expect('}')) {
+                return false;
+            }
+        }
+
+        if ((type == "Polygon" && coordDepth == 3) || (type == "MultiPolygon" && coordDepth == 4)) {
+            for (size_t i = 0; i < polyCount; ++i) {
+                emit(polys[i]);
+            }
+        }
+        return true;
+    }
+
+    // the elements of a FeatureCollection, numbering them as it goes
+    bool features(int depth) {
+        if (!accept('[')) {
+            return value(depth);
+        }
+        if (accept(']')) {
+            return true;
+        }
+        feature = 0;
+        do {
+            if (!value(depth + 1)) {
+                return false;
+            }
+            ++feature;
+        } while (accept(','));
+        return expect(']');
+    }
+
+    // Parses the arrays nested three (Polygon) or four (MultiPolygon) deep;
+    // other coordinate arrays are skipped. The nesting is known from the
+    // leading brackets before the type, which may come later in the object.
+    bool coordinates(int depth, int &coordDepth) {
+        coordDepth = 0;
+        for (const char *p = cur; p < end && (*p == '[' || isspace(static_cast<unsigned char>(*p)));
+             ++p) {
+            coordDepth += *p == '[';
+        }
+        polyCount = 0;
+        if (coordDepth == 3) {
+            if (polys.empty()) {
+                polys.emplace_back();
+            }
+            polyCount = 1;
+            return polygon(polys[0]);
+        }
+        if (coordDepth != 4) {
+            return value(depth);
+        }
+        if (!expect('[')) {
+            return false;
+        }
+        do {
+            if (polyCount == polys.size()) {
+                polys.emplace_back();
+            }
+            if (!polygon(polys[polyCount++])) {
+                return false;
+            }
+        } while (accept(','));
+        return expect(']');
+    }
+
+    bool polygon(Rings &rings) {
+        if (!expect('[')) {
+            return false;
+        }
+        size_t n = 0;
+        if (!accept(']')) {
+            do {
+                if (n == rings.size()) {
+                    rings.emplace_back();
+                }
+                if (!ring(rings[n++])) {
+                    return false;
+                }
+            } while (accept(','));
+            if (!expect(']')) {
+                return false;
+            }
+        }
+        rings.resize(n);
+        return true;
+    }
+
+    bool ring(Polygon &ring) {
+        ring.clear();
+        if (!expect('[')) {
+            return false;
+        }
+        if (accept(']')) {
+            return true;
+        }
+        Point p;
+        Scalar ignored;
+        do {
+            if (!expect('[') || !number(p.x) || !expect(',') || !number(p.y)) {
+                return false;
+            }
+            while (accept(',')) {
+                if (!number(ignored)) {
+                    return false;
+                }
+            }
+            if (!expect(']')) {
+                return false;
+            }
+            ring.push_back(p);
+        } while (accept(','));
+        closeRing(ring);
+        return expect(']');
+    }
+};
+
+} // namespace
+
+template <class Parser>
+static bool readFile(const char *path, const PolygonCallback &callback, string &error) {
+    MappedFile file(path, true);
+    if (!file.ok()) {
+        error = file.error();
+        return false;
+    }
+    Parser parser(file, callback);
+    if (!parser.parse()) {
+        error = string(path) + ": " + parser.error();
+        return false;
+    }
+    return true;
+}
+
+bool readWKT(const char *path, const PolygonCallback &callback, string &error) {
+    return readFile<WKTParser>(path, callback, error);
+}
+
+bool readGeoJSON(const char *path, const PolygonCallback &callback, string &error) {
+    return readFile<GeoJSONParser>(path, callback, error);
+}
+
+GISWriter::GISWriter(const char *path, Format format) : format(format) {
+    file = fopen(path, "w");
+    if (!file) {
+        err = string(path) + ": " + strerror(errno);
+        return;
+    }
+    if (format == GeoJSON) {
+        fputs("{\"type\":\"FeatureCollection\",\"features\":[", file);
+    }
+}
+
+GISWriter::~GISWriter() {
+    if (file) {
+        finish();
+    }
+}
+
+void GISWriter::writeRing(const Polygon &ring) {
+    if (ring.empty()) {
+        return;
+    }
+    const char *point = format == WKT ? "%.9g %.9g" : "[%.9g,%.9g]";
+    fputc(format == WKT ? '(' : '[', file);
+    for (const Point &p : ring) {
+        fprintf(file, point, p.x, p.y);
+        fputc(',', file);
+    }
+    fprintf(file, point, ring[0].x, ring[0].y);
+    fputc(format == WKT ? ')' : ']', file);
+}
+
+void GISWriter::write(const vector<Polygon> &pieces, size_t source) {
+    if (!ok()) {
+        return;
+    }
+    // an empty piece has no ring to close, so it is left out
+    bool empty = all_of(pieces.begin(), pieces.end(),
+                        [](const Polygon &piece) { return piece.empty(); });
+    if (format == WKT) {
+        fputs(empty ? "MULTIPOLYGON EMPTY" : "MULTIPOLYGON (", file);
+    } else {
+        fprintf(file,
+                "%s\n{\"type\":\"Feature\",\"properties\":{\"source\":%zu},"
+                "\"geometry\":{\"type\":\"MultiPolygon\",\"coordinates\":[",
+                count ? "," : "", source);
+    }
+    bool first = true;
+    for (const Polygon &piece : pieces) {
+        if (piece.empty()) {
+            continue;
+        }
+        if (!first) {
+            fputc(',', file);
+        }
+        first = false;
+        fputc(format == WKT ? '(' : '[', file);
+        writeRing(piece);
+        fputc(format == WKT ? ')' : ']', file);
+    }
+    if (format == WKT) {
+        fputs(empty ? "\n" : ")\n", file);
+    } else {
+        fputs("]}}", file);
+    }
+    ++count;
+    if (ferror(file)) {
+        err = strerror(errno);
+    }
+}
+
+bool GISWriter::finish() {
+    if (!file) {
+        return ok();
+    }
+    if (format == GeoJSON) {
+        fputs("\n]}\n", file);
+    }
+    if (ferror(file) && ok()) {
+        err = strerror(errno);
+    }
+    if (fclose(file) != 0 && ok()) {
+        err = strerror(errno);
+    }
+    file = nullptr;
+    return ok();
+}
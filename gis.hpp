@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <string>
+
+#include "point.hpp"
+
+// Streaming readers for polygons in Well-Known Text and GeoJSON. The file is
+// mapped and parsed in a single pass, and every polygon goes to the callback
+// as soon as its last ring has been read, so memory stays at one polygon no
+// matter how large the file is. The callback may take the rings over by
+// swapping them out. Closing vertices repeating the first one are dropped,
+// extra ordinates (Z, M) are ignored and other geometry types are skipped.
+// Each polygon comes with the index of the feature it belongs to: the WKT
+// entry, or the element of the "features" array in GeoJSON. The polygons of a
+// multipolygon share it, and features without polygons still take an index.
+typedef function<void(Rings &rings, size_t feature)> PolygonCallback;
+
+// POLYGON and MULTIPOLYGON entries one after another, also inside a
+// GEOMETRYCOLLECTION. An EWKT "SRID=n;" prefix is accepted.
+bool readWKT(const char *path, const PolygonCallback &callback, string &error);
+
+// Polygon and MultiPolygon geometries anywhere in the document, usually the
+// features of a FeatureCollection.
+bool readGeoJSON(const char *path, const PolygonCallback &callback, string &error);
+
+// Writes the convex pieces of each input polygon as one MULTIPOLYGON line of
+// WKT, or as one MultiPolygon feature of a GeoJSON FeatureCollection whose
+// "source" property is the index of the input feature the polygon came from.
+// Rings are written closed, as both formats require.
+class GISWriter {
+public:
+    enum Format { WKT, GeoJSON };
+
+    GISWriter(const char *path, Format format);
+    ~GISWriter();
+
+    GISWriter(const GISWriter &) = delete;
+    GISWriter &operator=(const GISWriter &) = delete;
+
+    bool ok() const { return err.empty(); }
+    const string &error() const { return err; }
+
+    void write(const vector<Polygon> &pieces, size_t source);
+
+    // closes the collection; called by the destructor if needed
+    bool finish();
+
+private:
+    FILE *file = nullptr;
+    Format format;
+    size_t count = 0;
+    string err;
+
+    void writeRing(const Polygon &ring);
+};
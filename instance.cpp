@@ -0,0 +1,203 @@
+#include "instance.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// Area, centroid and central second moments of a simple polygon, signed by
+// orientation. Sums run relative to the first vertex to keep precision far
+// from the origin.
+struct Moments {
+    double area = 0, cx = 0, cy = 0, xx = 0, yy = 0, xy = 0;
+
+    explicit Moments(const Polygon &poly) {
+        double ox = poly[0].x, oy = poly[0].y;
+        for (size_t i = 0; i < poly.size(); ++i) {
+            const Point &p = poly[i], &q = poly[(i + 1) % poly.size()];
+            double x0 = p.x - ox, y0 = p.y - oy, x1 = q.x - ox, y1 = q.y - oy;
+            double cross = x0 * y1 - x1 * y0;
+            area += cross;
+            cx += (x0 + x1) * cross;
+            cy += (y0 + y1) * cross;
+            xx += (x0 * x0 + x0 * x1 + x1 * x1) * cross;
+            yy += (y0 * y0 + y0 * y1 + y1 * y1) * cross;
+            xy += (x0 * y1 + 2 * x0 * y0 + 2 * x1 * y1 + x1 * y0) * cross;
+        }
+        area /= 2;
+        if (area == 0) {
+            return;
+        }
+        cx /= 6 * area;
+        cy /= 6 * area;
+        xx = xx / 12 - area * cx * cx;
+        yy = yy / 12 - area * cy * cy;
+        xy = xy / 24 - area * cx * cy;
+        cx += ox;
+        cy += oy;
+    }
+};
+
+} // namespace
+
+Instancer::Instance Instancer::decompose(const Polygon &poly, Decomposition &out) {
+    Instance instance = {0, Transform(), 0, false};
+    size_t n = poly.size();
+    if (n < 3) {
+        return instance;
+    }
+
+    // counter-clockwise view of the input
+    Moments m(poly);
+    bool reversed = m.area < 0;
+    Polygon ring(n);
+    for (size_t k = 0; k < n; ++k) {
+        ring[k] = poly[reversed ? (n - k) % n : k];
+    }
+    double sign = reversed ? -1 : 1, area = fabs(m.area);
+    double xx = sign * m.xx, yy = sign * m.yy, xy = sign * m.xy;
+    Scalar size = sqrt(max(xx + yy, 0.0) / max(area, 1e-30));
+
+    // Candidate frames: both directions of the principal axis, and x
+    // pointing at each of the farthest vertices. The axis is only precise
+    // for clearly elongated shapes, so the others are normalized by their
+    // farthest vertex; either way the frame a template was built with is
+    // among the candidates of every copy.
+    vector<double> axis, farthest;
+    double spread = sqrt((xx - yy) * (xx - yy) + 4 * xy * xy);
+    if (spread > 1e-3 * (xx + yy)) {
+        double theta = atan2(2 * xy, xx - yy) / 2;
+        axis.push_back(theta);
+        axis.push_back(theta + PI);
+    }
+    double far = 0;
+    for (const Point &p : ring) {
+        far = max(far, hypot(p.x - m.cx, p.y - m.cy));
+    }
+    for (const Point &p : ring) {
+        if (hypot(p.x - m.cx, p.y - m.cy) >= far * (1 - 1e-3) && farthest.size() < 16) {
+            farthest.push_back(atan2(p.y - m.cy, p.x - m.cx));
+        }
+    }
+    bool elongated = spread > 0.1 * (xx + yy);
+    vector<double> angles = elongated ? axis : farthest;
+    angles.insert(angles.end(), elongated ? farthest.begin() : axis.begin(),
+                  elongated ? farthest.end() : axis.end());
+
+    // neighboring area buckets too, so shapes on a boundary still meet
+    int64_t bucket = llround(log(max(area, 1e-30)) * 1000);
+    Polygon normalized(n);
+    bool matched = false;
+    for (size_t a = 0; a < angles.size() && !matched; ++a) {
+        double angle = angles[a];
+        Transform t;
+        t.c = cos(angle);
+        t.s = sin(angle);
+        t.tx = m.cx;
+        t.ty = m.cy;
+        for (size_t k = 0; k < n; ++k) {
+            double dx = ring[k].x - m.cx, dy = ring[k].y - m.cy;
+            normalized[k] = Point(t.c * dx + t.s * dy, -t.s * dx + t.c * dy);
+        }
+        if (a == 0) {
+            // a new shape is normalized with the first frame and starts at
+            // its vertex farthest along x, which copies find without a scan
+            // of every start
+            size_t start = max_element(normalized.begin(), normalized.end(),
+                                       [](const Point &p, const Point &q) { return p.x < q.x; }) -
+                           normalized.begin();
+            instance.transform = t;
+            instance.shape = templates.size();
+            instance.first = start;
+            templates.push_back({Polygon(), Decomposition()});
+            templates.back().ring.assign(normalized.begin() + start, normalized.end());
+            templates.back().ring.insert(templates.back().ring.end(), normalized.begin(),
+                                         normalized.begin() + start);
+        }
+        for (int64_t b = bucket - 1; b <= bucket + 1 && !matched; ++b) {
+            auto it = buckets.find(uint64_t(n) << 40 ^ uint64_t(b));
+            for (size_t i = 0; it != buckets.end() && i < it->second.size() && !matched; ++i) {
+                uint32_t id = it->second[i];
+                if (match(templates[id], normalized, size, instance)) {
+                    instance.shape = id;
+                    instance.transform = t;
+                    matched = true;
+                }
+            }
+        }
+    }
+
+    if (matched) {
+        templates.pop_back();
+    } else {
+        Template &shape = templates.back();
+        shape.pieces.output = Decomposition::Indices;
+        decomposePoly(shape.ring, shape.pieces);
+        if (shape.pieces.firstIndex.empty()) {
+            shape.pieces.firstIndex.push_back(0);
+        }
+        buckets[uint64_t(n) << 40 ^ uint64_t(bucket)].push_back(instance.shape);
+    }
+
+    // template vertex k sits at ring[first + k], i.e. at this input index
+    instance.reversed = reversed;
+    instance.first = reversed ? (n - instance.first) % n : instance.first;
+    auto input = [&](uint32_t k) {
+        return uint32_t(reversed ? (instance.first + n - k % n) % n : (instance.first + k) % n);
+    };
+
+    const Decomposition &pieces = templates[instance.shape].pieces;
+    uint32_t steinerBase = out.steinerPoints.size();
+    for (const Point &p : pieces.steinerPoints) {
+        out.steinerPoints.push_back(instance.transform.apply(p));
+    }
+    size_t count = pieces.firstIndex.size() - 1;
+    for (size_t i = 0; i < count; ++i) {
+        if (out.output & Decomposition::Indices) {
+            if (out.firstIndex.empty()) {
+                out.firstIndex.push_back(0);
+            }
+            for (uint32_t k = pieces.firstIndex[i]; k < pieces.firstIndex[i + 1]; ++k) {
+                uint32_t id = pieces.indices[k];
+                out.indices.push_back(id < n ? input(id) : id + steinerBase);
+            }
+            out.firstIndex.push_back(out.indices.size());
+        }
+        if (out.wantsPolygons()) {
+            Polygon piece;
+            for (uint32_t k = pieces.firstIndex[i]; k < pieces.firstIndex[i + 1]; ++k) {
+                uint32_t id = pieces.indices[k];
+                piece.push_back(id < n ? poly[input(id)]
+                                       : out.steinerPoints[id - n + steinerBase]);
+            }
+            out.addPolygon(piece);
+        }
+    }
+    return instance;
+}
+
+// whether ring, normalized, is the template's ring started at another
+// vertex; found.first receives that vertex. Only vertices within the
+// tolerance of the template's first one can start it.
+bool Instancer::match(const Template &shape, const Polygon &ring, Scalar size,
+                      Instance &found) const {
+    size_t n = ring.size();
+    Scalar limit = tolerance * size;
+    auto near = [&](size_t i, size_t k) {
+        return fabs(ring[i].x - shape.ring[k].x) <= limit &&
+               fabs(ring[i].y - shape.ring[k].y) <= limit;
+    };
+    for (size_t first = 0; first < n; ++first) {
+        if (!near(first, 0)) {
+            continue;
+        }
+        size_t k = 1;
+        while (k < n && near((first + k) % n, k)) {
+            ++k;
+        }
+        if (k == n) {
+            found.first = first;
+            return true;
+        }
+    }
+    return false;
+}
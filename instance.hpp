@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "decomp.hpp"
+
+// Rigid motion p -> R p + t, R rotating by the angle with cosine c and
+// sine s.
+struct Transform {
+    Scalar c = 1, s = 0, tx = 0, ty = 0;
+
+    Point apply(const Point &p) const {
+        return Point(c * p.x - s * p.y + tx, s * p.x + c * p.y + ty);
+    }
+};
+
+// Decomposes each distinct shape once when polygons repeat at different
+// positions and orientations. A ring is normalized by moving its area
+// centroid to the origin and turning its principal axis onto x (for shapes
+// that are not clearly elongated, the direction to a farthest vertex serves
+// instead). Rings that then agree vertex by vertex within the tolerance,
+// relative to the size of the shape, are instances of one template; the
+// template is decomposed once. Templates start at their vertex farthest
+// along x, so a copy is only compared from its vertices near that one.
+//
+// Not thread safe; use one per worker.
+class Instancer {
+public:
+    explicit Instancer(Scalar tolerance = 1e-4f) : tolerance(tolerance) {}
+
+    struct Instance {
+        uint32_t shape;
+        Transform transform;
+        // input vertex of template vertex k: first + k, or first - k when
+        // the input runs clockwise, modulo the size
+        uint32_t first;
+        bool reversed;
+    };
+
+    // Finds or adds the shape of poly and appends its pieces to out, placed
+    // by the instance transform. Indexed output refers to the vertices of
+    // poly itself; only Steiner points are transformed copies.
+    Instance decompose(const Polygon &poly, Decomposition &out);
+
+    size_t shapes() const { return templates.size(); }
+    // normalized outline and decomposition of a shape, for instanced drawing
+    const Polygon &outline(size_t shape) const { return templates[shape].ring; }
+    const Decomposition &pieces(size_t shape) const { return templates[shape].pieces; }
+
+private:
+    struct Template {
+        Polygon ring;
+        Decomposition pieces;
+    };
+    Scalar tolerance;
+    vector<Template> templates;
+    // shapes by vertex count and area bucket
+    unordered_map<uint64_t, vector<uint32_t>> buckets;
+
+    bool match(const Template &shape, const Polygon &ring, Scalar size, Instance &found) const;
+};
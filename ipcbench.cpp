@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#include "client.hpp"
+
+// Measures the round trip latency and the pipelined throughput of a running
+// polydecomp_server over its socket and over shared memory. Start the server
+// with a short deadline (-l 0) so batching does not hide the transport; -c
+// sends convex rings, which cost the server next to nothing to decompose.
+
+static Polygon makeRing(size_t n, mt19937 &rng, bool convex) {
+    uniform_real_distribution<Scalar> jitter(convex ? 1.0f : 0.8f, 1.0f);
+    Polygon poly;
+    for (size_t i = 0; i < n; ++i) {
+        double a = 2 * PI * i / n;
+        double r = 1000 * jitter(rng) * (convex ? 1 : 1 + 0.3 * sin(a * 17));
+        poly.push_back(Point(r * cos(a), r * sin(a)));
+    }
+    return poly;
+}
+
+static double seconds(chrono::steady_clock::time_point since) {
+    return chrono::duration<double>(chrono::steady_clock::now() - since).count();
+}
+
+// runs the same jobs through either client
+template <class Client>
+static bool measure(const char *name, Client &client, const Rings &job, size_t jobs,
+                    size_t window) {
+    Decomposition result;
+    vector<double> latency;
+    for (size_t i = 0; i < jobs; ++i) {
+        auto start = chrono::steady_clock::now();
+        if (!client.decompose(job, result)) {
+            fprintf(stderr, "%s: %s\n", name, client.error().c_str());
+            return false;
+        }
+        latency.push_back(seconds(start) * 1e6);
+    }
+    sort(latency.begin(), latency.end());
+
+    auto start = chrono::steady_clock::now();
+    uint32_t id;
+    for (size_t i = 0; i < jobs + window; ++i) {
+        if ((i < jobs && !client.send(i, job)) ||
+            (i >= window && !client.receive(id, result))) {
+            fprintf(stderr, "%s: %s\n", name, client.error().c_str());
+            return false;
+        }
+    }
+    double elapsed = seconds(start);
+    printf("%-6s  median %7.1f us  p99 %7.1f us  pipelined %8.0f jobs/s\n", name,
+           latency[latency.size() / 2], latency[latency.size() * 99 / 100], jobs / elapsed);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t vertices = 200, jobs = 1000, window = 64;
+    bool convex = false;
+    const char *path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            vertices = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            jobs = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            window = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0) {
+            convex = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path || !jobs) {
+        fprintf(stderr, "usage: ipcbench [-c] [-n vertices] [-q jobs] [-w window] socket\n");
+        return 2;
+    }
+
+    mt19937 rng(1);
+    Rings job(1, makeRing(vertices, rng, convex));
+    printf("%zu %s vertices, %zu jobs, %zu in flight\n", vertices, convex ? "convex" : "star",
+           jobs, window);
+
+    DecompositionClient socket(path);
+    SharedMemoryClient shared(path);
+    if (!socket.ok() || !shared.ok()) {
+        fprintf(stderr, "%s\n", (socket.ok() ? shared.error() : socket.error()).c_str());
+        return 1;
+    }
+    return measure("socket", socket, job, jobs, window) &&
+                   measure("shm", shared, job, jobs, window)
+               ? 0
+               : 1;
+}
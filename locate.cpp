@@ -0,0 +1,163 @@
+#include "locate.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+void PieceIndex::build(const vector<Polygon> &pieces) {
+    tree.clear();
+    ids.clear();
+    firstPlane.clear();
+    nx.clear();
+    ny.clear();
+    c.clear();
+    if (pieces.empty()) {
+        return;
+    }
+
+    vector<Node> boxes(pieces.size());
+    vector<uint32_t> items(pieces.size());
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        Node &box = boxes[i];
+        box.minX = box.minY = numeric_limits<Scalar>::max();
+        box.maxX = box.maxY = -numeric_limits<Scalar>::max();
+        for (const Point &p : pieces[i]) {
+            box.minX = std::min(box.minX, p.x);
+            box.minY = std::min(box.minY, p.y);
+            box.maxX = max(box.maxX, p.x);
+            box.maxY = max(box.maxY, p.y);
+        }
+        items[i] = i;
+    }
+    tree.reserve(2 * pieces.size() / leafSize + 1);
+    buildNode(items, 0, items.size(), boxes);
+
+    for (uint32_t id : items) {
+        const Polygon &piece = pieces[id];
+        ids.push_back(id);
+        firstPlane.push_back(c.size());
+        for (size_t i = 0; i < piece.size(); ++i) {
+            const Point &a = piece[i], &b = piece[(i + 1) % piece.size()];
+            Scalar dx = b.x - a.x, dy = b.y - a.y, length = sqrt(dx * dx + dy * dy);
+            if (length == 0) {
+                continue;
+            }
+            // outward unit normal, with some slack so that rounding does
+            // not drop points lying on an edge
+            Scalar slack = 1e-6f * (fabs(a.x) + fabs(a.y) + 1);
+            nx.push_back(dy / length);
+            ny.push_back(-dx / length);
+            c.push_back(nx.back() * a.x + ny.back() * a.y + slack);
+        }
+        while (c.size() % 4) {
+            nx.push_back(0);
+            ny.push_back(0);
+            c.push_back(numeric_limits<Scalar>::max());
+        }
+    }
+    firstPlane.push_back(c.size());
+}
+
+// median split on the longest axis of the box centers
+uint32_t PieceIndex::buildNode(vector<uint32_t> &items, size_t first, size_t last,
+                               const vector<Node> &boxes) {
+    uint32_t index = tree.size();
+    tree.emplace_back();
+    Node node = boxes[items[first]];
+    Scalar lowX = numeric_limits<Scalar>::max(), lowY = lowX, highX = -lowX, highY = -lowX;
+    for (size_t i = first; i < last; ++i) {
+        const Node &box = boxes[items[i]];
+        node.minX = std::min(node.minX, box.minX);
+        node.minY = std::min(node.minY, box.minY);
+        node.maxX = max(node.maxX, box.maxX);
+        node.maxY = max(node.maxY, box.maxY);
+        lowX = std::min(lowX, box.minX + box.maxX);
+        lowY = std::min(lowY, box.minY + box.maxY);
+        highX = max(highX, box.minX + box.maxX);
+        highY = max(highY, box.minY + box.maxY);
+    }
+
+    if (last - first <= leafSize) {
+        node.first = first;
+        node.count = last - first;
+        tree[index] = node;
+        return index;
+    }
+
+    bool splitX = highX - lowX >= highY - lowY;
+    size_t mid = (first + last) / 2;
+    nth_element(items.begin() + first, items.begin() + mid, items.begin() + last,
+                [&](uint32_t l, uint32_t r) {
+                    return splitX ? boxes[l].minX + boxes[l].maxX < boxes[r].minX + boxes[r].maxX
+                                  : boxes[l].minY + boxes[l].maxY < boxes[r].minY + boxes[r].maxY;
+                });
+    buildNode(items, first, mid, boxes);
+    node.first = buildNode(items, mid, last, boxes);
+    node.count = 0;
+    tree[index] = node;
+    return index;
+}
+
+bool PieceIndex::contains(uint32_t item, const Point &p) const {
+    const Scalar *px = nx.data(), *py = ny.data(), *pc = c.data();
+    uint32_t last = firstPlane[item + 1];
+#ifdef __SSE__
+    __m128 x = _mm_set1_ps(p.x), y = _mm_set1_ps(p.y);
+    for (uint32_t k = firstPlane[item]; k < last; k += 4) {
+        __m128 d = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(px + k), x), _mm_mul_ps(_mm_loadu_ps(py + k), y));
+        if (_mm_movemask_ps(_mm_cmpgt_ps(d, _mm_loadu_ps(pc + k)))) {
+            return false;
+        }
+    }
+    return true;
+#else
+    bool inside = true;
+    for (uint32_t k = firstPlane[item]; k < last; ++k) {
+        inside &= px[k] * p.x + py[k] * p.y <= pc[k];
+    }
+    return inside;
+#endif
+}
+
+int32_t PieceIndex::locate(const Point &p) const {
+    if (tree.empty()) {
+        return -1;
+    }
+    uint32_t stack[64];
+    int top = 0;
+    uint32_t index = 0;
+    for (;;) {
+        const Node &node = tree[index];
+        if (p.x >= node.minX && p.x <= node.maxX && p.y >= node.minY && p.y <= node.maxY) {
+            if (node.count == 0) {
+                stack[top++] = node.first;
+                ++index;
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                if (contains(i, p)) {
+                    return ids[i];
+                }
+            }
+        }
+        if (top == 0) {
+            return -1;
+        }
+        index = stack[--top];
+    }
+}
+
+void PieceIndex::locate(const Point *points, size_t count, int32_t *out) const {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = locate(points[i]);
+    }
+}
+
+void PieceIndex::locate(const Point *points, size_t count, int32_t *out, Engine &engine) const {
+    engine.parallelFor(count, [&](size_t first, size_t last) {
+        locate(points + first, last - first, out + first);
+    });
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+#include "engine.hpp"
+
+// Point location over convex pieces. Piece bounding boxes go into a flat BVH
+// laid out depth first, so the left child of a node is the next node and the
+// traversal walks memory mostly forwards. Each piece is kept as the
+// half-planes of its edges, padded to groups of four that are tested in one
+// SSE step; points on a shared edge are reported in either piece.
+class PieceIndex {
+public:
+    PieceIndex() {}
+    explicit PieceIndex(const vector<Polygon> &pieces) { build(pieces); }
+
+    // pieces must be convex and counter-clockwise, as decomposePoly emits them
+    void build(const vector<Polygon> &pieces);
+
+    // index of a piece containing p, or -1
+    int32_t locate(const Point &p) const;
+    void locate(const Point *points, size_t count, int32_t *out) const;
+    // splits the batch over the engine's threads
+    void locate(const Point *points, size_t count, int32_t *out, Engine &engine) const;
+
+    size_t pieces() const { return ids.size(); }
+    size_t nodes() const { return tree.size(); }
+
+private:
+    // inner nodes have count 0 and their right child at index first
+    struct Node {
+        Scalar minX, minY, maxX, maxY;
+        uint32_t first, count;
+    };
+    vector<Node> tree;
+    // pieces in leaf order: original index and range of half-planes
+    vector<uint32_t> ids, firstPlane;
+    // half-plane k holds the points with nx[k] * x + ny[k] * y <= c[k]
+    vector<Scalar> nx, ny, c;
+
+    static const int leafSize = 4;
+
+    uint32_t buildNode(vector<uint32_t> &items, size_t first, size_t last,
+                       const vector<Node> &boxes);
+    bool contains(uint32_t item, const Point &p) const;
+};
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#include "locate.hpp"
+#include "reader.hpp"
+
+// Decomposes a polygon (the first one of a text file, or a generated ring)
+// and measures point location throughput on its pieces.
+
+static Polygon makeRing(size_t n, mt19937 &rng) {
+    uniform_real_distribution<Scalar> jitter(0.8f, 1.0f);
+    Polygon poly;
+    for (size_t i = 0; i < n; ++i) {
+        double a = 2 * PI * i / n;
+        double r = 1000 * jitter(rng) * (1 + 0.3 * sin(a * 17));
+        poly.push_back(Point(r * cos(a), r * sin(a)));
+    }
+    return poly;
+}
+
+static double seconds(chrono::steady_clock::time_point since) {
+    return chrono::duration<double>(chrono::steady_clock::now() - since).count();
+}
+
+int main(int argc, char **argv) {
+    size_t vertices = 2000, queries = 2000000;
+    const char *path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            vertices = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            queries = atol(argv[++i]);
+        } else {
+            path = argv[i];
+        }
+    }
+
+    mt19937 rng(1);
+    Polygon poly;
+    if (path) {
+        PolygonReader reader(path);
+        if (!reader.next(poly)) {
+            fprintf(stderr, "%s\n", reader.ok() ? "no polygon" : reader.error().c_str());
+            return 1;
+        }
+    } else {
+        poly = makeRing(vertices, rng);
+    }
+
+    Decomposition decomp;
+    decomposePoly(poly, decomp);
+    auto start = chrono::steady_clock::now();
+    PieceIndex index(decomp.polys);
+    printf("%zu vertices, %zu pieces, %zu nodes, built in %.2f ms\n", poly.size(),
+           index.pieces(), index.nodes(), seconds(start) * 1e3);
+
+    Scalar minX = poly[0].x, minY = poly[0].y, maxX = minX, maxY = minY;
+    for (const Point &p : poly) {
+        minX = std::min(minX, p.x);
+        minY = std::min(minY, p.y);
+        maxX = max(maxX, p.x);
+        maxY = max(maxY, p.y);
+    }
+    uniform_real_distribution<Scalar> x(minX, maxX), y(minY, maxY);
+    vector<Point> points(queries);
+    for (Point &p : points) {
+        p = Point(x(rng), y(rng));
+    }
+    vector<int32_t> found(queries);
+
+    start = chrono::steady_clock::now();
+    index.locate(points.data(), points.size(), found.data());
+    double single = seconds(start);
+    size_t hits = count_if(found.begin(), found.end(), [](int32_t i) { return i >= 0; });
+
+    Engine engine;
+    start = chrono::steady_clock::now();
+    index.locate(points.data(), points.size(), found.data(), engine);
+    double threaded = seconds(start);
+
+    printf("%zu queries, %zu inside\n", queries, hits);
+    printf("1 thread:  %.1f M queries/s\n", queries / single * 1e-6);
+    printf("%u threads: %.1f M queries/s\n", engine.threads(), queries / threaded * 1e-6);
+    return 0;
+}
@@ -5,30 +5,26 @@
 
 #include <camera.hpp>
 #include <earcut.hpp>
+#include <cstring>
 #include <shader.hpp>
 #include <string>
+#include <thread>
 
+#include "decomp.hpp"
+#include "engine.hpp"
+#include "instance.hpp"
 #include "point.hpp"
-
-namespace mapbox {
-namespace util {
-template <> struct nth<0, Point> {
-  static int64_t get(const Point &t) { return t.x; };
-};
-
-template <> struct nth<1, Point> {
-  static int64_t get(const Point &t) { return t.y; };
-};
-
-} // namespace util
-} // namespace mapbox
-
-typedef std::vector<Point> Polygon;
+#include "reader.hpp"
+#include "simplify.hpp"
+#include "spsc.hpp"
+#include "triangulate.hpp"
 
 static const char *vertex_shader_text = R"SHADER(
 #version 410
 
 layout (location = 0) in vec2 position;
+// rotation cosine and sine, then translation, of an instance
+layout (location = 1) in vec4 placement;
 
 uniform mat4 matrix;
 uniform vec4 u_color;
@@ -37,7 +33,9 @@ out vec4 vs_color;
 
 void main()
 {
-    gl_Position = matrix * vec4(position, 0.0, 1.0);
+    vec2 p = vec2(placement.x * position.x - placement.y * position.y,
+                  placement.y * position.x + placement.x * position.y);
+    gl_Position = matrix * vec4(p + placement.zw, 0.0, 1.0);
     vs_color = u_color;
 }
 
@@ -65,13 +63,42 @@ Polygon currPoly;
 int mouse_x, mouse_y;
 bool polyComplete = false;
 
-vector<Polygon> polys;
-vector<Point> steinerPoints, reflexVertices;
+Decomposition decomp;
+
+// the drawn polygon is decomposed off the render thread, ahead of any other
+// work on the pool; its pieces come back through the queue as they are
+// found and the frame loop adds them to the drawing
+SpscQueue<Polygon> arriving(1024);
+Engine engine;
+DecompositionFuture pending;
+
+// Douglas-Peucker tolerance applied before decomposition, 0 disables it,
+// and the vertices it removed from the current polygon
+Scalar simplifyTolerance = 0;
+int simplified = 0;
+
+// the pieces drawn so far; new pieces are triangulated and uploaded on their
+// own, behind those already in the buffers
+TriangleBatch batch;
+bool batchDirty = false;
+size_t uploadedVertices = 0, uploadedIndices = 0;
+size_t vertexCapacity = 0, indexCapacity = 0;
+bool uploadedWide = false;
+
+// polygons of a file opened with -i, drawn as instances of their shapes:
+// the pieces of every shape are uploaded once, each copy only adds its
+// transform
+TriangleBatch shapeBatch;
+// first piece of each shape in shapeBatch and first transform of its
+// copies, one extra entry at the end
+vector<uint32_t> shapePieces, firstPlacement;
+vector<Transform> placements;
 
-bool isReflex(const Polygon &p, const int &i);
-void makeCCW(Polygon &poly);
 void initGraphics();
-void decomposePoly(Polygon poly);
+void uploadBatch(GLuint vbo, GLuint ibo);
+void completePoly();
+void dropPending();
+void loadInstances(const char *path);
 
 std::vector<glm::vec4> colors = {
     glm::vec4(1.0f, 0.0, 0.0, 1.0), glm::vec4(0.0f, 1.0, 0.0, 1.0),
@@ -79,7 +106,7 @@ std::vector<glm::vec4> colors = {
     glm::vec4(1.0f, 0.0, 1.0, 1.0), glm::vec4(0.0f, 1.0, 1.0, 1.0),
     glm::vec4(1.0f, 0.53, 0.0, 1.0)};
 
-int main() {
+int main(int argc, char **argv) {
 
   // init
   glfwInit();
@@ -102,13 +129,26 @@ int main() {
       return;
     switch (key) {
     case 'C':
+      dropPending();
       currPoly.clear();
-      polys.clear();
+      decomp.clear();
       polyComplete = false;
-      steinerPoints.clear();
-      reflexVertices.clear();
+      batch.clear();
       printf("---\n");
       break;
+    case '=':
+    case '-': {
+      simplifyTolerance = key == '=' ? simplifyTolerance + 0.5f
+                                     : max(simplifyTolerance - 0.5f, 0.0f);
+      // the tolerance shows in the title bar
+      char title[64] = "polydecomp";
+      if (simplifyTolerance > 0) {
+        snprintf(title, sizeof(title), "polydecomp - simplify %g px",
+                 simplifyTolerance);
+      }
+      glfwSetWindowTitle(window, title);
+      break;
+    }
     }
   });
   glfwSetMouseButtonCallback(
@@ -124,9 +164,7 @@ int main() {
             break;
           }
         case GLFW_MOUSE_BUTTON_RIGHT:
-          polyComplete = true;
-          makeCCW(currPoly);
-          decomposePoly(currPoly);
+          completePoly();
           break;
         }
       });
@@ -135,6 +173,19 @@ int main() {
     mouse_y = y;
   });
 
+  // optionally start from the first polygon of a text file, or show all of
+  // them instanced
+  if (argc > 2 && strcmp(argv[1], "-i") == 0) {
+    loadInstances(argv[2]);
+  } else if (argc > 1) {
+    PolygonReader reader(argv[1]);
+    if (reader.next(currPoly)) {
+      completePoly();
+    } else if (!reader.ok()) {
+      fprintf(stderr, "%s\n", reader.error().c_str());
+    }
+  }
+
   glfwMakeContextCurrent(window);
   gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
 
@@ -158,6 +209,28 @@ int main() {
 
   GLuint ibo;
   glGenBuffers(1, &ibo);
+  // drawing outside the instances leaves them where they are
+  glVertexAttrib4f(1, 1.0f, 0.0f, 0.0f, 0.0f);
+
+  // the shapes and their transforms go up once
+  GLuint shapeVao, shapeBuffers[3];
+  glGenVertexArrays(1, &shapeVao);
+  glBindVertexArray(shapeVao);
+  glGenBuffers(3, shapeBuffers);
+  glBindBuffer(GL_ARRAY_BUFFER, shapeBuffers[0]);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(Point) * shapeBatch.vertices.size(),
+               shapeBatch.vertices.data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shapeBuffers[1]);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               shapeBatch.indexSize() * shapeBatch.indexCount(),
+               shapeBatch.indexData(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, shapeBuffers[2]);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(Transform) * placements.size(),
+               placements.data(), GL_STATIC_DRAW);
+  glVertexAttribDivisor(1, 1);
+  glEnableVertexAttribArray(1);
 
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -169,6 +242,56 @@ int main() {
     shader.use();
     shader.setMat4("matrix", glm::ortho(0.0f, width, height, 0.0f));
 
+    // a finished job has queued all its pieces already
+    bool finished = pending.valid() && pending.ready();
+    size_t drawn = decomp.polys.size();
+    Polygon piece;
+    while (arriving.pop(piece)) {
+      decomp.polys.push_back(move(piece));
+    }
+    if (decomp.polys.size() > drawn) {
+      triangulate(decomp.polys, drawn, batch);
+    }
+    if (finished) {
+      if (pending.wait()) {
+        Decomposition done = pending.get();
+        decomp.steinerPoints = move(done.steinerPoints);
+        decomp.reflexVertices = move(done.reflexVertices);
+        printf("Pieces: %d, Steiner points: %d, reflex vertices: %d, "
+               "simplified: %d\n",
+               (int)decomp.polys.size(), (int)decomp.steinerPoints.size(),
+               (int)decomp.reflexVertices.size(), simplified);
+      }
+      pending = DecompositionFuture();
+    }
+
+    if (shapeBatch.pieces() > 0) {
+      GLenum indexType = shapeBatch.wide ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+      glBindVertexArray(shapeVao);
+      glBindBuffer(GL_ARRAY_BUFFER, shapeBuffers[2]);
+      for (size_t s = 0; s + 1 < shapePieces.size(); ++s) {
+        // the copies of this shape
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0,
+                              (void *)(firstPlacement[s] * sizeof(Transform)));
+        GLsizei copies = firstPlacement[s + 1] - firstPlacement[s];
+        for (uint32_t i = shapePieces[s]; i < shapePieces[s + 1]; ++i) {
+          GLsizei count =
+              shapeBatch.firstIndex[i + 1] - shapeBatch.firstIndex[i];
+          shader.setVec4("u_color", colors[i % colors.size()]);
+          glDrawElementsInstanced(
+              GL_TRIANGLES, count, indexType,
+              (void *)(shapeBatch.firstIndex[i] * shapeBatch.indexSize()),
+              copies);
+          glLineWidth(1);
+          shader.setVec4("u_color", glm::vec4(1.0f, 1.0f, 1.0f, 1.0));
+          glDrawArraysInstanced(GL_LINE_STRIP, shapeBatch.firstVertex[i],
+                                shapeBatch.firstVertex[i + 1] -
+                                    shapeBatch.firstVertex[i],
+                                copies);
+        }
+      }
+    }
+
     if (!polyComplete) {
       if (currPoly.size() > 0) {
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
@@ -193,25 +316,22 @@ int main() {
         glDrawArrays(GL_LINE_STRIP, 0, lastLine.size());
       }
     } else {
-      for (int i = 0; i < polys.size(); ++i) {
-        // convex polygon
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Point) * polys[i].size(),
-                     polys[i].data(), GL_DYNAMIC_DRAW);
+      // the index buffer binding belongs to the vertex array
+      glBindVertexArray(vao);
+      uploadBatch(vbo, ibo);
 
-        auto indices = mapbox::earcut<uint16_t>(std::vector<Polygon>{polys[i]});
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * indices.size(),
-                     indices.data(), GL_DYNAMIC_DRAW);
-        glBindVertexArray(vao);
+      GLenum indexType = batch.wide ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+      for (int i = 0; i < batch.pieces(); ++i) {
+        // convex polygon
+        GLsizei count = batch.firstIndex[i + 1] - batch.firstIndex[i];
         shader.setVec4("u_color", colors[i % colors.size()]);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_SHORT,
-                       nullptr);
+        glDrawElements(GL_TRIANGLES, count, indexType,
+                       (void *)(batch.firstIndex[i] * batch.indexSize()));
         // outline
         glLineWidth(3);
         shader.setVec4("u_color", glm::vec4(1.0f, 1.0f, 1.0f, 1.0));
-        glDrawArrays(GL_LINE_STRIP, 0, polys[i].size());
+        glDrawArrays(GL_LINE_STRIP, batch.firstVertex[i],
+                     batch.firstVertex[i + 1] - batch.firstVertex[i]);
       }
     }
 
@@ -219,172 +339,138 @@ int main() {
     glfwSwapBuffers(window);
   }
 
+  dropPending();
   glfwTerminate();
 }
 
-void makeCCW(Polygon &poly) {
-  int br = 0;
-
-  // find bottom right point
-  for (int i = 1; i < poly.size(); ++i) {
-    if (poly[i].y < poly[br].y ||
-        (poly[i].y == poly[br].y && poly[i].x > poly[br].x)) {
-      br = i;
-    }
+// Sends the vertices and indices of the batch that are not in the buffers
+// yet. A buffer that is too small is reallocated at twice the size and filled
+// again, as are the indices when they widen to 32 bits.
+void uploadBatch(GLuint vbo, GLuint ibo) {
+  if (batchDirty) {
+    // the vertex buffer held the outline while it was drawn
+    uploadedVertices = uploadedIndices = 0;
+    vertexCapacity = indexCapacity = 0;
+    uploadedWide = false;
+    batchDirty = false;
   }
-
-  // reverse poly if clockwise
-  if (!left(at(poly, br - 1), at(poly, br), at(poly, br + 1))) {
-    reverse(poly.begin(), poly.end());
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  if (batch.vertices.size() > vertexCapacity) {
+    vertexCapacity = std::max(2 * batch.vertices.size(), size_t(1024));
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Point) * vertexCapacity, nullptr,
+                 GL_DYNAMIC_DRAW);
+    uploadedVertices = 0;
+  }
+  if (batch.vertices.size() > uploadedVertices) {
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(Point) * uploadedVertices,
+                    sizeof(Point) * (batch.vertices.size() - uploadedVertices),
+                    batch.vertices.data() + uploadedVertices);
+    uploadedVertices = batch.vertices.size();
   }
-}
 
-bool isReflex(const Polygon &poly, const int &i) {
-  return right(at(poly, i - 1), at(poly, i), at(poly, i + 1));
+  // index capacity is in bytes, as the index size may change
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+  if (batch.wide != uploadedWide) {
+    uploadedIndices = 0;
+    uploadedWide = batch.wide;
+  }
+  size_t indexBytes = batch.indexSize() * batch.indexCount();
+  if (indexBytes > indexCapacity) {
+    indexCapacity = std::max(2 * indexBytes, size_t(4096));
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity, nullptr,
+                 GL_DYNAMIC_DRAW);
+    uploadedIndices = 0;
+  }
+  if (batch.indexCount() > uploadedIndices) {
+    const char *data = static_cast<const char *>(batch.indexData());
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                    batch.indexSize() * uploadedIndices,
+                    indexBytes - batch.indexSize() * uploadedIndices,
+                    data + batch.indexSize() * uploadedIndices);
+    uploadedIndices = batch.indexCount();
+  }
 }
 
-Point intersection(const Point &p1, const Point &p2, const Point &q1,
-                   const Point &q2) {
-  Point i;
-  Scalar a1, b1, c1, a2, b2, c2, det;
-  a1 = p2.y - p1.y;
-  b1 = p1.x - p2.x;
-  c1 = a1 * p1.x + b1 * p1.y;
-  a2 = q2.y - q1.y;
-  b2 = q1.x - q2.x;
-  c2 = a2 * q1.x + b2 * q1.y;
-  det = a1 * b2 - a2 * b1;
-  if (!eq(det, 0)) { // lines are not parallel
-    i.x = (b2 * c1 - b1 * c2) / det;
-    i.y = (a1 * c2 - a2 * c1) / det;
+void completePoly() {
+  polyComplete = true;
+  cleanPoly(currPoly);
+  simplified = 0;
+  if (simplifyTolerance > 0) {
+    simplified = simplifyPoly(currPoly, simplifyTolerance);
   }
-  return i;
+  makeCCW(currPoly);
+  dropPending();
+  decomp.clear();
+  batch.clear();
+  batchDirty = true;
+  Rings rings = {currPoly};
+  pending = engine.submit(rings, 0, Priority::Interactive,
+                          [](const Polygon &piece) {
+                            // the frame loop drains the queue
+                            while (!arriving.push(piece)) {
+                              std::this_thread::yield();
+                            }
+                          });
 }
 
-void swap(int &a, int &b) {
-  int c;
-  c = a;
-  a = b;
-  b = c;
+// Stops the pending job and throws away the pieces it sent. The queue takes
+// one producer at a time, so the job has to be over before the next starts.
+void dropPending() {
+  if (!pending.valid()) {
+    return;
+  }
+  pending.cancel();
+  Polygon piece;
+  do {
+    while (arriving.pop(piece)) {
+    }
+  } while (!pending.ready());
+  while (arriving.pop(piece)) {
+  }
+  pending = DecompositionFuture();
 }
 
-void decomposePoly(Polygon poly) {
-  Point upperInt, lowerInt, p, closestVert;
-  Scalar upperDist, lowerDist, d, closestDist;
-  int upperIndex, lowerIndex, closestIndex;
-  Polygon lowerPoly, upperPoly;
-
-  for (int i = 0; i < poly.size(); ++i) {
-    if (isReflex(poly, i)) {
-      reflexVertices.push_back(poly[i]);
-      upperDist = lowerDist = numeric_limits<Scalar>::max();
-      for (int j = 0; j < poly.size(); ++j) {
-        if (left(at(poly, i - 1), at(poly, i), at(poly, j)) &&
-            rightOn(at(poly, i - 1), at(poly, i),
-                    at(poly, j - 1))) { // if line intersects with an edge
-          p = intersection(at(poly, i - 1), at(poly, i), at(poly, j),
-                           at(poly, j - 1)); // find the point of intersection
-          if (right(at(poly, i + 1), at(poly, i),
-                    p)) { // make sure it's inside the poly
-            d = sqdist(poly[i], p);
-            if (d < lowerDist) { // keep only the closest intersection
-              lowerDist = d;
-              lowerInt = p;
-              lowerIndex = j;
-            }
-          }
-        }
-        if (left(at(poly, i + 1), at(poly, i), at(poly, j + 1)) &&
-            rightOn(at(poly, i + 1), at(poly, i), at(poly, j))) {
-          p = intersection(at(poly, i + 1), at(poly, i), at(poly, j),
-                           at(poly, j + 1));
-          if (left(at(poly, i - 1), at(poly, i), p)) {
-            d = sqdist(poly[i], p);
-            if (d < upperDist) {
-              upperDist = d;
-              upperInt = p;
-              upperIndex = j;
-            }
-          }
-        }
-      }
-
-      // if there are no vertices to connect to, choose a point in the middle
-      if (lowerIndex == (upperIndex + 1) % poly.size()) {
-        printf("Case 1: Vertex(%d), lowerIndex(%d), upperIndex(%d), "
-               "poly.size(%d)\n",
-               i, lowerIndex, upperIndex, (int)poly.size());
-        p.x = (lowerInt.x + upperInt.x) / 2;
-        p.y = (lowerInt.y + upperInt.y) / 2;
-        steinerPoints.push_back(p);
-
-        if (i < upperIndex) {
-          lowerPoly.insert(lowerPoly.end(), poly.begin() + i,
-                           poly.begin() + upperIndex + 1);
-          lowerPoly.push_back(p);
-          upperPoly.push_back(p);
-          if (lowerIndex != 0)
-            upperPoly.insert(upperPoly.end(), poly.begin() + lowerIndex,
-                             poly.end());
-          upperPoly.insert(upperPoly.end(), poly.begin(), poly.begin() + i + 1);
-        } else {
-          if (i != 0)
-            lowerPoly.insert(lowerPoly.end(), poly.begin() + i, poly.end());
-          lowerPoly.insert(lowerPoly.end(), poly.begin(),
-                           poly.begin() + upperIndex + 1);
-          lowerPoly.push_back(p);
-          upperPoly.push_back(p);
-          upperPoly.insert(upperPoly.end(), poly.begin() + lowerIndex,
-                           poly.begin() + i + 1);
-        }
-      } else {
-        // connect to the closest point within the triangle
-        printf("Case 2: Vertex(%d), closestIndex(%d), poly.size(%d)\n", i,
-               closestIndex, (int)poly.size());
-
-        if (lowerIndex > upperIndex) {
-          upperIndex += poly.size();
-        }
-        closestDist = numeric_limits<Scalar>::max();
-        for (int j = lowerIndex; j <= upperIndex; ++j) {
-          if (leftOn(at(poly, i - 1), at(poly, i), at(poly, j)) &&
-              rightOn(at(poly, i + 1), at(poly, i), at(poly, j))) {
-            d = sqdist(at(poly, i), at(poly, j));
-            if (d < closestDist) {
-              closestDist = d;
-              closestVert = at(poly, j);
-              closestIndex = j % poly.size();
-            }
-          }
-        }
-
-        if (i < closestIndex) {
-          lowerPoly.insert(lowerPoly.end(), poly.begin() + i,
-                           poly.begin() + closestIndex + 1);
-          if (closestIndex != 0)
-            upperPoly.insert(upperPoly.end(), poly.begin() + closestIndex,
-                             poly.end());
-          upperPoly.insert(upperPoly.end(), poly.begin(), poly.begin() + i + 1);
-        } else {
-          if (i != 0)
-            lowerPoly.insert(lowerPoly.end(), poly.begin() + i, poly.end());
-          lowerPoly.insert(lowerPoly.end(), poly.begin(),
-                           poly.begin() + closestIndex + 1);
-          upperPoly.insert(upperPoly.end(), poly.begin() + closestIndex,
-                           poly.begin() + i + 1);
-        }
-      }
+void loadInstances(const char *path) {
+  PolygonReader reader(path);
+  Instancer instancer;
+  vector<vector<Transform>> copies;
+  Polygon poly;
+  while (reader.next(poly)) {
+    cleanPoly(poly);
+    if (poly.size() < 3) {
+      continue;
+    }
+    // only the instance is wanted, the pieces are drawn from the shapes
+    Decomposition none;
+    none.output = 0;
+    Instancer::Instance instance = instancer.decompose(poly, none);
+    copies.resize(instancer.shapes());
+    copies[instance.shape].push_back(instance.transform);
+  }
+  if (!reader.ok()) {
+    fprintf(stderr, "%s\n", reader.error().c_str());
+  }
 
-      // solve smallest poly first
-      if (lowerPoly.size() < upperPoly.size()) {
-        decomposePoly(lowerPoly);
-        decomposePoly(upperPoly);
-      } else {
-        decomposePoly(upperPoly);
-        decomposePoly(lowerPoly);
+  // pieces of every shape in its normalized frame
+  vector<Polygon> pieces;
+  for (size_t s = 0; s < instancer.shapes(); ++s) {
+    const Polygon &ring = instancer.outline(s);
+    const Decomposition &shape = instancer.pieces(s);
+    shapePieces.push_back(pieces.size());
+    firstPlacement.push_back(placements.size());
+    for (size_t i = 0; i + 1 < shape.firstIndex.size(); ++i) {
+      pieces.emplace_back();
+      for (uint32_t k = shape.firstIndex[i]; k < shape.firstIndex[i + 1]; ++k) {
+        uint32_t id = shape.indices[k];
+        pieces.back().push_back(id < ring.size()
+                                    ? ring[id]
+                                    : shape.steinerPoints[id - ring.size()]);
       }
-      return;
     }
+    placements.insert(placements.end(), copies[s].begin(), copies[s].end());
   }
-  polys.push_back(poly);
+  shapePieces.push_back(pieces.size());
+  firstPlacement.push_back(placements.size());
+  triangulate(pieces, shapeBatch);
+  printf("%zu polygons as %zu shapes\n", placements.size(), instancer.shapes());
 }
@@ -0,0 +1,52 @@
+#include "mapped.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const size_t releaseChunk = size_t(64) << 20;
+
+MappedFile::MappedFile(const char *path, bool sequential) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        err = string(path) + ": " + strerror(errno);
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        length = st.st_size;
+    }
+    if (length > 0) {
+        void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            err = string(path) + ": " + strerror(errno);
+            length = 0;
+        } else {
+            if (sequential) {
+                madvise(mapped, length, MADV_SEQUENTIAL);
+            }
+            begin = static_cast<const char *>(mapped);
+        }
+    }
+    close(fd);
+    released = begin;
+}
+
+MappedFile::~MappedFile() {
+    if (begin) {
+        munmap(const_cast<char *>(begin), length);
+    }
+}
+
+void MappedFile::release(const char *p) {
+    if (size_t(p - released) < releaseChunk) {
+        return;
+    }
+    const char *upto = begin + (p - begin) / releaseChunk * releaseChunk;
+    madvise(const_cast<char *>(released), upto - released, MADV_DONTNEED);
+    released = upto;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include "common.hpp"
+
+// Read-only mapping of a whole file.
+class MappedFile {
+public:
+    MappedFile(const char *path, bool sequential = false);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool ok() const { return err.empty(); }
+    const string &error() const { return err; }
+
+    const char *data() const { return begin; }
+    const char *end() const { return begin + length; }
+    size_t size() const { return length; }
+
+    // Drops the whole 64 MiB chunks below p from memory once a sequential
+    // reader is done with them; they are read again if touched later.
+    void release(const char *p);
+
+private:
+    const char *begin = nullptr;
+    const char *released = nullptr;
+    size_t length = 0;
+    string err;
+};
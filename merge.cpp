@@ -0,0 +1,13 @@
+#include "merge.hpp"
+
+#include <algorithm>
+
+size_t mergePolygons(vector<Polygon> &pieces) {
+    size_t saved = mergeNeighbors(
+        pieces, [](const Point &p) { return p; },
+        [](const Point &, const Point &) { return true; });
+    pieces.erase(remove_if(pieces.begin(), pieces.end(),
+                           [](const Polygon &piece) { return piece.empty(); }),
+                 pieces.end());
+    return saved;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+#include "point.hpp"
+
+// Merging of neighboring convex pieces. Pieces are counter-clockwise rings of
+// any vertex type, either points or vertex ids, with position(vertex) giving
+// the coordinates.
+
+inline bool sameVertex(uint32_t a, uint32_t b) {
+    return a == b;
+}
+
+inline bool sameVertex(const Point &a, const Point &b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+inline uint64_t directedEdgeKey(uint32_t a, uint32_t b) {
+    return uint64_t(a) << 32 | b;
+}
+
+inline uint64_t directedEdgeKey(const Point &a, const Point &b) {
+    uint32_t words[4];
+    memcpy(words, &a, sizeof(Point));
+    memcpy(words + 2, &b, sizeof(Point));
+    uint64_t h = 0;
+    for (uint32_t w : words) {
+        h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+    }
+    return h;
+}
+
+// Greedy pass that fuses pieces across the edges they share: every edge u-v
+// with shared(u, v) is looked up reversed among the edges of the other
+// pieces, and the two pieces are merged where their union is convex.
+// Vertices left straight where pieces meet are dropped unless keepStraight
+// is set. The merged piece takes the place of the lower one and the other
+// is left empty.
+//
+// The pieces are held as rings of linked corners while merging, so a merge
+// only relinks the four corners at the shared edge and checks the two
+// corners whose angles change: one hash lookup and constant work per shared
+// edge, however large the merged pieces grow. Returns the number of pieces
+// saved.
+template <class Vertex, class Position, class Shared>
+size_t mergeNeighbors(vector<vector<Vertex>> &pieces, Position position, Shared shared,
+                      bool keepStraight = false) {
+    // corner k is vertex[k] with the edge to vertex[next[k]]
+    vector<Vertex> vertex;
+    vector<uint32_t> next, prev, pieceOf;
+    vector<uint32_t> first(pieces.size()), size(pieces.size());
+    for (uint32_t i = 0; i < pieces.size(); ++i) {
+        first[i] = vertex.size();
+        size[i] = pieces[i].size();
+        for (size_t k = 0; k < pieces[i].size(); ++k) {
+            uint32_t corner = vertex.size();
+            vertex.push_back(pieces[i][k]);
+            next.push_back(k + 1 < pieces[i].size() ? corner + 1 : first[i]);
+            prev.push_back(k > 0 ? corner - 1 : first[i] + pieces[i].size() - 1);
+            pieceOf.push_back(i);
+        }
+    }
+    // the edges as they were before any merge
+    const vector<uint32_t> to = next;
+    vector<bool> removed(vertex.size());
+
+    unordered_multimap<uint64_t, uint32_t> edges;
+    vector<uint32_t> candidates;
+    for (uint32_t k = 0; k < vertex.size(); ++k) {
+        const Vertex &a = vertex[k], &b = vertex[next[k]];
+        if (shared(a, b)) {
+            edges.insert({directedEdgeKey(a, b), k});
+            candidates.push_back(k);
+        }
+    }
+
+    // merged pieces live on in their representative, which starts its ring
+    // at head
+    vector<uint32_t> owner(pieces.size()), head(pieces.size());
+    for (uint32_t i = 0; i < owner.size(); ++i) {
+        owner[i] = i;
+        head[i] = first[i];
+    }
+    auto find = [&](uint32_t piece) {
+        while (owner[piece] != piece) {
+            piece = owner[piece] = owner[owner[piece]];
+        }
+        return piece;
+    };
+    // the corner still has its edge from a to b
+    auto hasEdge = [&](uint32_t k, const Vertex &a, const Vertex &b) {
+        return !removed[k] && sameVertex(vertex[k], a) && sameVertex(vertex[next[k]], b);
+    };
+    auto unlink = [&](uint32_t k) {
+        next[prev[k]] = next[k];
+        prev[next[k]] = prev[k];
+        removed[k] = true;
+    };
+
+    size_t saved = 0;
+    vector<bool> merged(pieces.size());
+    for (uint32_t e : candidates) {
+        const Vertex a = vertex[e], b = vertex[to[e]];
+        auto range = edges.equal_range(directedEdgeKey(b, a));
+        for (auto it = range.first; it != range.second; ++it) {
+            uint32_t t = it->second;
+            if (pieceOf[t] <= pieceOf[e] || !sameVertex(vertex[t], b) ||
+                !sameVertex(vertex[to[t]], a)) {
+                continue;
+            }
+            uint32_t p = find(pieceOf[e]), q = find(pieceOf[t]);
+            if (p == q || !hasEdge(e, a, b) || !hasEdge(t, b, a)) {
+                break;
+            }
+            // the corners at a and b are the only ones the union changes
+            uint32_t bFirst = next[e], aSecond = next[t];
+            Point beforeA = position(vertex[prev[e]]), afterA = position(vertex[next[aSecond]]);
+            Point beforeB = position(vertex[prev[t]]), afterB = position(vertex[next[bFirst]]);
+            Point pa = position(a), pb = position(b);
+            if (!leftOn(beforeA, pa, afterA) || !leftOn(beforeB, pb, afterB)) {
+                break;
+            }
+            bool keepA = keepStraight || left(beforeA, pa, afterA);
+            bool keepB = keepStraight || left(beforeB, pb, afterB);
+            uint32_t total = size[p] + size[q] - 2 - !keepA - !keepB;
+            if (total < 3) {
+                break;
+            }
+
+            // the corners of the shared edge go, and each side runs on into
+            // the corner of the other that leaves the same vertex
+            next[prev[e]] = aSecond;
+            prev[aSecond] = prev[e];
+            next[prev[t]] = bFirst;
+            prev[bFirst] = prev[t];
+            removed[e] = removed[t] = true;
+            head[p] = keepB ? bFirst : next[bFirst];
+            if (!keepB) {
+                unlink(bFirst);
+            }
+            if (!keepA) {
+                unlink(aSecond);
+            }
+
+            if (q < p) {
+                swap(p, q);
+                head[p] = head[q];
+            }
+            size[p] = total;
+            owner[q] = p;
+            merged[p] = true;
+            merged[q] = false;
+            pieces[q].clear();
+            ++saved;
+            break;
+        }
+    }
+
+    // write back the rings of the pieces merges made
+    for (uint32_t i = 0; i < pieces.size(); ++i) {
+        if (!merged[i]) {
+            continue;
+        }
+        pieces[i].clear();
+        uint32_t k = head[i];
+        do {
+            pieces[i].push_back(vertex[k]);
+            k = next[k];
+        } while (k != head[i]);
+    }
+    return saved;
+}
+
+// Merges neighboring pieces of a finished decomposition wherever their
+// union stays convex, matching shared edges by their coordinates, and
+// removes the pieces merged away. Returns how many that were.
+size_t mergePolygons(vector<Polygon> &pieces);
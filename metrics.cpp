@@ -0,0 +1,192 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "triangulate.hpp"
+
+constexpr double DecompositionMetrics::sliverAspect;
+
+void DecompositionMetrics::add(const DecompositionMetrics &other) {
+    if (pieces + other.pieces) {
+        meanAspect = (meanAspect * pieces + other.meanAspect * other.pieces) /
+                     (pieces + other.pieces);
+    }
+    pieces += other.pieces;
+    steinerPoints += other.steinerPoints;
+    minAngle = min(minAngle, other.minAngle);
+    maxAspect = max(maxAspect, other.maxAspect);
+    diagonalLength += other.diagonalLength;
+    slivers += other.slivers;
+}
+
+static double perimeter(const Point *ring, size_t n) {
+    double length = 0;
+    for (size_t i = 0, j = n - 1; i < n; j = i++) {
+        length += hypot(double(ring[i].x) - ring[j].x, double(ring[i].y) - ring[j].y);
+    }
+    return length;
+}
+
+namespace {
+
+// Running totals over the pieces. The smallest angle is tracked by its
+// cosine, so acos is taken once at the end.
+struct PieceMeasure {
+    DecompositionMetrics &m;
+    double maxCos = -1, aspects = 0, perimeters = 0;
+
+    void add(const Point *piece, size_t n) {
+        double area = 0, longest = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const Point &prev = piece[(i + n - 1) % n], &p = piece[i], &next = piece[(i + 1) % n];
+            double ux = double(prev.x) - p.x, uy = double(prev.y) - p.y;
+            double vx = double(next.x) - p.x, vy = double(next.y) - p.y;
+            double lu = ux * ux + uy * uy, lv = vx * vx + vy * vy;
+            if (lu > 0 && lv > 0) {
+                maxCos = max(maxCos, (ux * vx + uy * vy) / sqrt(lu * lv));
+            }
+            perimeters += sqrt(lv);
+            longest = max(longest, lv);
+            area += double(p.x) * next.y - double(next.x) * p.y;
+        }
+        area = fabs(area) / 2;
+        double aspect = area > 0 ? longest / area : numeric_limits<double>::infinity();
+        m.maxAspect = max(m.maxAspect, aspect);
+        aspects += aspect;
+        m.slivers += aspect > DecompositionMetrics::sliverAspect;
+        ++m.pieces;
+    }
+};
+
+} // namespace
+
+DecompositionMetrics measure(const Rings &rings, const Decomposition &out) {
+    DecompositionMetrics m;
+    m.steinerPoints = out.steinerPoints.size();
+    PieceMeasure pieces{m};
+    if ((out.output & Decomposition::Polygons) || out.firstIndex.empty()) {
+        for (const Polygon &piece : out.polys) {
+            pieces.add(piece.data(), piece.size());
+        }
+    } else {
+        vector<Point> verts;
+        for (const Polygon &ring : rings) {
+            verts.insert(verts.end(), ring.begin(), ring.end());
+        }
+        verts.insert(verts.end(), out.steinerPoints.begin(), out.steinerPoints.end());
+        Polygon piece;
+        for (size_t i = 0; i + 1 < out.firstIndex.size(); ++i) {
+            piece.clear();
+            for (uint32_t k = out.firstIndex[i]; k < out.firstIndex[i + 1]; ++k) {
+                piece.push_back(verts[out.indices[k]]);
+            }
+            pieces.add(piece.data(), piece.size());
+        }
+    }
+    if (m.pieces) {
+        m.minAngle = acos(min(pieces.maxCos, 1.0)) * 180 / PI;
+        m.meanAspect = pieces.aspects / m.pieces;
+    }
+
+    // every diagonal borders two pieces, every input edge one piece or a
+    // remainder
+    double boundary = 0, covered = pieces.perimeters;
+    for (const Polygon &ring : rings) {
+        boundary += perimeter(ring.data(), ring.size());
+    }
+    for (const Polygon &rest : out.remainder) {
+        covered += perimeter(rest.data(), rest.size());
+    }
+    m.diagonalLength = max(0.0, (covered - boundary) / 2);
+    return m;
+}
+
+InputFeatures inputFeatures(const Rings &rings) {
+    InputFeatures features;
+    for (size_t r = 0; r < rings.size(); ++r) {
+        const Polygon &ring = rings[r];
+        size_t n = ring.size();
+        if (n < 3) {
+            continue;
+        }
+        ++features.rings;
+        features.vertices += n;
+        double sum = 0;
+        for (size_t i = 0, j = n - 1; i < n; j = i++) {
+            sum += (double(ring[j].x) - ring[i].x) * (double(ring[i].y) + ring[j].y);
+        }
+        // the interior is left of a counter-clockwise outline and right of
+        // a counter-clockwise hole
+        bool turnsRight = (sum > 0) == (r == 0);
+        for (size_t i = 0; i < n; ++i) {
+            const Point &prev = ring[(i + n - 1) % n], &p = ring[i], &next = ring[(i + 1) % n];
+            features.reflex += turnsRight ? right(prev, p, next) : left(prev, p, next);
+        }
+    }
+    return features;
+}
+
+double CostModel::predict(const InputFeatures &features, Algorithm algorithm) const {
+    double n = features.vertices, r = features.reflex;
+    switch (algorithm) {
+    case Algorithm::Passthrough:
+        return perVertex * n;
+    case Algorithm::SingleSplit:
+        return 2 * perVertex * n;
+    case Algorithm::Bayazit:
+        return perBayazitStep * n * (r + 1) + perBayazitSplit * r;
+    case Algorithm::Earcut:
+        return perEarcutStep * n * log2(n + 2);
+    }
+    return 0;
+}
+
+// microseconds per call, over at least a millisecond of calls
+template <class F> static double timeCalls(F f) {
+    auto start = chrono::steady_clock::now();
+    double elapsed;
+    size_t calls = 0;
+    do {
+        f();
+        ++calls;
+        elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < 1000);
+    return elapsed / calls;
+}
+
+// a star with every other vertex reflex
+static Polygon star(size_t n) {
+    Polygon poly;
+    for (size_t i = 0; i < n; ++i) {
+        double angle = 2 * PI * i / n, radius = i % 2 ? 600 : 1000;
+        poly.push_back(Point(radius * cos(angle), radius * sin(angle)));
+    }
+    return poly;
+}
+
+void CostModel::calibrate() {
+    Rings rings(1, star(4096));
+    InputFeatures features = inputFeatures(rings);
+    perVertex = timeCalls([&]() { features = inputFeatures(rings); }) / features.vertices;
+    perEarcutStep = timeCalls([&]() { mapbox::earcut<uint32_t, PointLayout>(rings); }) /
+                    (features.vertices * log2(features.vertices + 2));
+
+    // the scan dominates on a large star and the splits on a small one
+    double steps[2], splits[2], micros[2];
+    for (int i = 0; i < 2; ++i) {
+        Polygon poly = star(i ? 512 : 32);
+        features = inputFeatures(Rings(1, poly));
+        steps[i] = features.vertices * (features.reflex + 1.0);
+        splits[i] = features.reflex;
+        Decomposition out;
+        micros[i] = timeCalls([&]() {
+            out.clear();
+            decomposePoly(poly, out);
+        });
+    }
+    double det = steps[1] * splits[0] - steps[0] * splits[1];
+    perBayazitStep = max(0.0, (micros[1] * splits[0] - micros[0] * splits[1]) / det);
+    perBayazitSplit = max(0.0, (micros[0] - perBayazitStep * steps[0]) / splits[0]);
+}
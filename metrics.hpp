@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+
+#include "decomp.hpp"
+
+// Quality of a decomposition, taken in one pass over the input and the
+// pieces so it can run on every result.
+struct DecompositionMetrics {
+    size_t pieces = 0, steinerPoints = 0;
+    // smallest interior angle of any piece, in degrees
+    double minAngle = 180;
+    // longest edge squared over area, 1 for a square and k for a k by 1
+    // rectangle: the largest and the mean over the pieces
+    double maxAspect = 0, meanAspect = 0;
+    // length of the diagonals, the piece boundaries not on the input
+    double diagonalLength = 0;
+    // pieces with an aspect above sliverAspect, and their share of pieces
+    size_t slivers = 0;
+    double sliverScore() const { return pieces ? double(slivers) / pieces : 0; }
+
+    static constexpr double sliverAspect = 20;
+
+    // combines the metrics of two results
+    void add(const DecompositionMetrics &other);
+};
+
+// Metrics of out, the decomposition of rings. Pieces are read from polys,
+// or from the index lists when only those were produced.
+DecompositionMetrics measure(const Rings &rings, const Decomposition &out);
+
+// What the running time of a decomposition depends on, in one pass over the
+// input.
+struct InputFeatures {
+    size_t vertices = 0, rings = 0;
+    // vertices with an interior angle above 180 degrees, holes included
+    size_t reflex = 0;
+    double reflexRatio() const { return vertices ? double(reflex) / vertices : 0; }
+};
+
+InputFeatures inputFeatures(const Rings &rings);
+
+enum class Algorithm {
+    // convex input handed back as its own piece
+    Passthrough,
+    // one reflex vertex resolved by a single diagonal
+    SingleSplit,
+    // decomposePoly
+    Bayazit,
+    // earcut triangles
+    Earcut
+};
+
+// Predicts the time an algorithm takes on an input from its features, in
+// microseconds. Each algorithm costs a coefficient times its complexity
+// term: n for the single pass of Passthrough, twice that for SingleSplit,
+// which copies the ring into two pieces, n (r + 1) for Bayazit, which scans
+// the ring for every reflex vertex it splits at, plus a fixed cost for each
+// of those splits, and n log n for earcut.
+// The defaults were measured on an optimized build; calibrate() measures
+// them again on this machine.
+class CostModel {
+public:
+    double perVertex = 0.01, perBayazitStep = 0.012, perBayazitSplit = 0.6,
+           perEarcutStep = 0.046;
+
+    double predict(const InputFeatures &features, Algorithm algorithm) const;
+    // times every algorithm on generated polygons, a few milliseconds
+    void calibrate();
+};
@@ -0,0 +1,178 @@
+#include "outofcore.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <unistd.h>
+
+#include "cut.hpp"
+#include "decomp.hpp"
+#include "mapped.hpp"
+#include "polyfile.hpp"
+
+// rough peak memory of decomposePoly per vertex: the ring, the index lists
+// of the recursion and the pieces
+static const size_t bytesPerVertex = 64;
+// cuts that stop halving the work end in a tile anyway
+static const int maxDepth = 64;
+// double rings are converted this many points at a time
+static const size_t chunkVertices = 1 << 16;
+
+namespace {
+
+// One side of a cut while it is written, closed and removed on any early
+// return; split clears file and path once it has closed and unlinked them.
+struct TempFile {
+    string path;
+    FILE *file = nullptr;
+
+    ~TempFile() {
+        if (file) {
+            fclose(file);
+        }
+        if (!path.empty()) {
+            unlink(path.c_str());
+        }
+    }
+};
+
+} // namespace
+
+OutOfCoreDecomposer::OutOfCoreDecomposer(size_t memoryBudget, const char *tempDir)
+    : tileVertices(max(memoryBudget / bytesPerVertex, size_t(16))) {
+    if (!tempDir) {
+        tempDir = getenv("TMPDIR");
+    }
+    this->tempDir = tempDir && *tempDir ? tempDir : "/tmp";
+}
+
+bool OutOfCoreDecomposer::decompose(const Point *ring, size_t n, const Sink &sink) {
+    return n < 3 || split([&](const Visit &visit) { visit(ring, n); }, n, 0, sink);
+}
+
+bool OutOfCoreDecomposer::decompose(const DoublePoint *ring, size_t n, const Sink &sink) {
+    Polygon chunk;
+    Walk walk = [&](const Visit &visit) {
+        for (size_t first = 0; first < n; first += chunkVertices) {
+            size_t count = std::min(chunkVertices, n - first);
+            chunk.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                chunk[i] = Point(Scalar(ring[first + i].x), Scalar(ring[first + i].y));
+            }
+            visit(chunk.data(), count);
+        }
+    };
+    return n < 3 || split(walk, n, 0, sink);
+}
+
+void OutOfCoreDecomposer::decomposeTile(const Walk &walk, size_t n, const Sink &sink) {
+    Polygon tile;
+    tile.reserve(n);
+    walk([&](const Point *points, size_t count) {
+        tile.insert(tile.end(), points, points + count);
+    });
+    Decomposition pieces;
+    pieces.output = 0;
+    pieces.sink = sink;
+    decomposePoly(tile, pieces);
+    ++tileCount;
+}
+
+bool OutOfCoreDecomposer::split(const Walk &walk, size_t n, int depth, const Sink &sink) {
+    Scalar lo[2] = {INFINITY, INFINITY}, hi[2] = {-INFINITY, -INFINITY};
+    walk([&](const Point *points, size_t count) {
+        for (const Point *p = points; p != points + count; ++p) {
+            lo[0] = std::min(lo[0], p->x);
+            hi[0] = max(hi[0], p->x);
+            lo[1] = std::min(lo[1], p->y);
+            hi[1] = max(hi[1], p->y);
+        }
+    });
+    int axis = hi[1] - lo[1] > hi[0] - lo[0];
+    if (n <= tileVertices || depth >= maxDepth || lo[axis] == hi[axis]) {
+        decomposeTile(walk, n, sink);
+        return true;
+    }
+
+    // both sides go to temporary files that are gone as soon as they are
+    // mapped again
+    TempFile temps[2];
+    for (TempFile &temp : temps) {
+        string path = tempDir + "/polydecomp-XXXXXX";
+        int fd = mkstemp(&path[0]);
+        if (fd < 0) {
+            err = path + ": " + strerror(errno);
+            return false;
+        }
+        temp.path = path;
+        if (!(temp.file = fdopen(fd, "wb"))) {
+            err = path + ": " + strerror(errno);
+            close(fd);
+            return false;
+        }
+    }
+    // errno of the first write or close that failed
+    int writeError = 0;
+    auto failed = [&writeError]() {
+        if (!writeError) {
+            writeError = errno ? errno : EIO;
+        }
+    };
+    RingCutter cutter(axis, cutPosition(lo[axis], hi[axis]),
+                      [&](int side, const Point *points, size_t count) {
+                          if (fwrite(points, sizeof(Point), count, temps[side].file) != count) {
+                              failed();
+                          }
+                      });
+    walk([&](const Point *points, size_t count) { cutter.add(points, count); });
+    vector<vector<PointRange>> rings[2];
+    cutter.finish(rings);
+    ++cutCount;
+
+    unique_ptr<MappedFile> sides[2];
+    for (int side = 0; side < 2; ++side) {
+        TempFile &temp = temps[side];
+        if (fclose(temp.file) != 0) {
+            failed();
+        }
+        temp.file = nullptr;
+        sides[side].reset(new MappedFile(temp.path.c_str(), true));
+        unlink(temp.path.c_str());
+        temp.path.clear();
+        if (!writeError && !sides[side]->ok()) {
+            err = sides[side]->error();
+            return false;
+        }
+    }
+    if (writeError) {
+        err = tempDir + ": " + strerror(writeError);
+        return false;
+    }
+    if (rings[0].empty() || rings[1].empty()) {
+        decomposeTile(walk, n, sink);
+        return true;
+    }
+
+    vector<Span> part;
+    for (int side = 0; side < 2; ++side) {
+        const Point *points = reinterpret_cast<const Point *>(sides[side]->data());
+        for (const vector<PointRange> &ranges : rings[side]) {
+            part.clear();
+            size_t count = 0;
+            for (const PointRange &range : ranges) {
+                part.push_back({points + range.first, size_t(range.count)});
+                count += range.count;
+            }
+            Walk spans = [&part](const Visit &visit) {
+                for (const Span &span : part) {
+                    visit(span.points, span.count);
+                }
+            };
+            if (count >= 3 && !split(spans, count, depth + 1, sink)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
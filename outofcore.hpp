@@ -0,0 +1,50 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "point.hpp"
+
+struct DoublePoint;
+
+// Decomposes rings too large to hold in memory. A ring over the budget is
+// cut in two across the middle of the longer side of its bounding box, the
+// points of either side streamed to a temporary file, and every resulting
+// ring is handled the same way until it fits. Those tiles are decomposed in
+// memory and their pieces handed to the sink one at a time. Input and
+// temporary files are only read through mappings, so peak memory follows
+// the budget rather than the input size.
+class OutOfCoreDecomposer {
+public:
+    typedef function<void(const Polygon &piece)> Sink;
+
+    // temporary files go to tempDir, or TMPDIR, or /tmp
+    OutOfCoreDecomposer(size_t memoryBudget, const char *tempDir = nullptr);
+
+    bool ok() const { return err.empty(); }
+    const string &error() const { return err; }
+
+    // the ring is only read, in order, e.g. straight from a mapped PolyFile
+    bool decompose(const Point *ring, size_t n, const Sink &sink);
+    // double rings are converted a bounded chunk at a time on every pass
+    bool decompose(const DoublePoint *ring, size_t n, const Sink &sink);
+
+    size_t tiles() const { return tileCount; }
+    size_t cuts() const { return cutCount; }
+
+private:
+    struct Span {
+        const Point *points;
+        size_t count;
+    };
+    // hands every point of a ring, in order, to visit in one or more parts
+    typedef function<void(const Point *points, size_t count)> Visit;
+    typedef function<void(const Visit &visit)> Walk;
+
+    size_t tileVertices;
+    string tempDir, err;
+    size_t tileCount = 0, cutCount = 0;
+
+    bool split(const Walk &walk, size_t n, int depth, const Sink &sink);
+    void decomposeTile(const Walk &walk, size_t n, const Sink &sink);
+};
@@ -0,0 +1,188 @@
+#include "piecestore.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+static void putVarint(vector<uint8_t> &out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back(uint8_t(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(uint8_t(v));
+}
+
+static uint32_t getVarint(const uint8_t *&p) {
+    uint32_t v = *p & 0x7f;
+    for (int shift = 7; *p++ & 0x80; shift += 7) {
+        v |= uint32_t(*p & 0x7f) << shift;
+    }
+    return v;
+}
+
+static uint32_t zigzag(int32_t v) {
+    return (uint32_t(v) << 1) ^ uint32_t(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return int32_t(v >> 1) ^ -int32_t(v & 1);
+}
+
+// exact coordinates as a hash key, -0 and 0 are the same point
+static uint64_t key(const Point &p) {
+    Scalar px = p.x + Scalar(0), py = p.y + Scalar(0);
+    uint32_t x, y;
+    memcpy(&x, &px, sizeof(x));
+    memcpy(&y, &py, sizeof(y));
+    return uint64_t(x) << 32 | y;
+}
+
+void PieceStore::add(const Point *verts, size_t n, const Decomposition &out) {
+    uint32_t base = xs.size();
+    firstVertex.push_back(base);
+    firstPiece.push_back(count);
+
+    for (size_t i = 0; i < n; ++i) {
+        xs.push_back(verts[i].x);
+        ys.push_back(verts[i].y);
+    }
+    for (const Point &p : out.steinerPoints) {
+        xs.push_back(p.x);
+        ys.push_back(p.y);
+    }
+
+    if (out.output & Decomposition::Indices) {
+        for (size_t i = 0; i + 1 < out.firstIndex.size(); ++i) {
+            addPiece(out.indices.data() + out.firstIndex[i],
+                     out.firstIndex[i + 1] - out.firstIndex[i]);
+        }
+        return;
+    }
+
+    // coordinate copies only, the ids are recovered by looking them up.
+    // Points that are not in the table (holes bridged by earcut, pieces
+    // translated back by the cache or the instancer) are added to it
+    unordered_map<uint64_t, uint32_t> ids;
+    ids.reserve(xs.size() - base);
+    for (uint32_t i = base; i < xs.size(); ++i) {
+        ids.emplace(key(Point(xs[i], ys[i])), i - base);
+    }
+    vector<uint32_t> piece;
+    for (const Polygon &poly : out.polys) {
+        piece.clear();
+        for (const Point &p : poly) {
+            auto found = ids.emplace(key(p), uint32_t(xs.size() - base));
+            if (found.second) {
+                xs.push_back(p.x);
+                ys.push_back(p.y);
+            }
+            piece.push_back(found.first->second);
+        }
+        addPiece(piece.data(), piece.size());
+    }
+}
+
+void PieceStore::add(const Polygon &poly, const Decomposition &out) {
+    add(poly.data(), poly.size(), out);
+}
+
+void PieceStore::addPiece(const uint32_t *ids, size_t n) {
+    if (count++ % blockSize == 0) {
+        blockStart.push_back(bytes.size());
+    }
+    putVarint(bytes, n);
+    uint32_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        putVarint(bytes, zigzag(int32_t(ids[i] - prev)));
+        prev = ids[i];
+    }
+}
+
+size_t PieceStore::source(size_t piece) const {
+    return upper_bound(firstPiece.begin(), firstPiece.end(), piece) - firstPiece.begin() - 1;
+}
+
+size_t PieceStore::decode(size_t piece, vector<Scalar> &x, vector<Scalar> &y) const {
+    // skip the pieces before this one in its block, a varint ends with
+    // every byte below 0x80
+    const uint8_t *p = bytes.data() + blockStart[piece / blockSize];
+    for (size_t skip = piece % blockSize; skip > 0; --skip) {
+        for (uint32_t left = getVarint(p); left > 0; left -= *p++ < 0x80) {
+        }
+    }
+    const Scalar *sx = xs.data() + firstVertex[source(piece)];
+    const Scalar *sy = ys.data() + firstVertex[source(piece)];
+    uint32_t count = getVarint(p), id = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        id += unzigzag(getVarint(p));
+        x.push_back(sx[id]);
+        y.push_back(sy[id]);
+    }
+    return count;
+}
+
+Polygon PieceStore::piece(size_t piece) const {
+    vector<Scalar> x, y;
+    decode(piece, x, y);
+    Polygon poly(x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        poly[i] = Point(x[i], y[i]);
+    }
+    return poly;
+}
+
+void PieceStore::decodeAll(vector<Scalar> &x, vector<Scalar> &y,
+                           vector<uint32_t> &firstOut) const {
+    x.clear();
+    y.clear();
+    firstOut.clear();
+    firstOut.reserve(pieces() + 1);
+
+    // every piece costs at least a byte per vertex plus its count, so the
+    // coded size bounds the output
+    x.reserve(bytes.size());
+    y.reserve(bytes.size());
+
+    const uint8_t *p = bytes.data();
+    size_t next = 0;
+    for (size_t s = 0; s < sources(); ++s) {
+        const Scalar *sx = xs.data() + firstVertex[s];
+        const Scalar *sy = ys.data() + firstVertex[s];
+        size_t last = s + 1 < sources() ? firstPiece[s + 1] : pieces();
+        for (; next < last; ++next) {
+            firstOut.push_back(x.size());
+            uint32_t count = getVarint(p), id = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                id += unzigzag(getVarint(p));
+                x.push_back(sx[id]);
+                y.push_back(sy[id]);
+            }
+        }
+    }
+    firstOut.push_back(x.size());
+}
+
+size_t PieceStore::memoryUsage() const {
+    return (xs.capacity() + ys.capacity()) * sizeof(Scalar) +
+           (firstVertex.capacity() + firstPiece.capacity()) * sizeof(uint32_t) +
+           bytes.capacity() + blockStart.capacity() * sizeof(uint64_t);
+}
+
+void PieceStore::shrinkToFit() {
+    xs.shrink_to_fit();
+    ys.shrink_to_fit();
+    firstVertex.shrink_to_fit();
+    firstPiece.shrink_to_fit();
+    bytes.shrink_to_fit();
+    blockStart.shrink_to_fit();
+}
+
+void PieceStore::clear() {
+    xs.clear();
+    ys.clear();
+    firstVertex.clear();
+    firstPiece.clear();
+    bytes.clear();
+    blockStart.clear();
+    count = 0;
+}
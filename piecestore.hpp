@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+#include "decomp.hpp"
+
+// Compact resident store for large numbers of decomposed pieces. Vertex
+// coordinates are kept once per source polygon: its ring followed by the
+// Steiner points of its decomposition. A piece only lists the ids of its
+// vertices within that table, coded as zigzag varint differences of
+// consecutive ids. Pieces mostly walk along the ring, so most vertices cost a
+// single byte instead of a pair of floats. Random access seeks from the
+// nearest of every 16th piece, so the offsets cost half a byte per piece.
+class PieceStore {
+public:
+    // Adds a polygon and the pieces decomposePoly produced for it; out must
+    // hold the decomposition of this polygon only. Indexed output is stored
+    // as it is, coordinate copies are matched against the vertices and any
+    // point not among them extends the table.
+    void add(const Point *verts, size_t n, const Decomposition &out);
+    void add(const Polygon &poly, const Decomposition &out);
+
+    size_t sources() const { return firstPiece.size(); }
+    size_t pieces() const { return count; }
+    size_t vertices() const { return xs.size(); }
+
+    // Decodes piece i, appending its coordinates to the SoA buffers. Returns
+    // the number of vertices.
+    size_t decode(size_t piece, vector<Scalar> &x, vector<Scalar> &y) const;
+    Polygon piece(size_t piece) const;
+
+    // Decodes every piece in order into the SoA buffers, firstVertex receives
+    // the start of each piece plus one entry for the end.
+    void decodeAll(vector<Scalar> &x, vector<Scalar> &y, vector<uint32_t> &firstVertex) const;
+
+    // bytes held by the store
+    size_t memoryUsage() const;
+    // releases the spare capacity left by growing the store
+    void shrinkToFit();
+    void clear();
+
+private:
+    // vertex table of all sources, ring then Steiner points
+    vector<Scalar> xs, ys;
+    // per source: first table entry and first piece
+    vector<uint32_t> firstVertex, firstPiece;
+    // coded pieces, and where every blockSize-th piece starts
+    vector<uint8_t> bytes;
+    vector<uint64_t> blockStart;
+    size_t count = 0;
+
+    static const size_t blockSize = 16;
+
+    void addPiece(const uint32_t *ids, size_t n);
+    size_t source(size_t piece) const;
+};
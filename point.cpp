@@ -10,11 +10,6 @@ Point operator+(const Point &a, const Point &b) {
     return Point(a.x + b.x, b.y + b.y);
 }
 
-Point::Point(ifstream& fin) {
-    char c;
-    fin >> c >> x >> c >> y >> c;
-}
-
 ostream & operator<<(ostream &os, const Point &p) {
     return os << "(" << p.x << ", " << p.y << ")";
 }
@@ -7,7 +7,6 @@ public:
     Scalar x, y;
 
     Point();
-    Point(ifstream& fin);
     Point(Scalar x, Scalar y);
 
     friend ostream & operator<<(ostream &os, const Point &p);
@@ -20,3 +19,8 @@ public:
     friend bool collinear(const Point &a, const Point &b, const Point &c);
     friend Scalar sqdist(const Point &a, const Point &b);
 };
+
+typedef vector<Point> Polygon;
+
+// A polygon with holes: the outline followed by one ring per hole.
+typedef vector<Polygon> Rings;
@@ -0,0 +1,370 @@
+#include <cstring>
+#include <memory>
+
+#include "client.hpp"
+#include "engine.hpp"
+#include "gis.hpp"
+#include "merge.hpp"
+#include "metrics.hpp"
+#include "outofcore.hpp"
+#include "piecestore.hpp"
+#include "polyfile.hpp"
+#include "reader.hpp"
+#include "simplify.hpp"
+#include "tiles.hpp"
+
+static int usage() {
+    fprintf(stderr, "usage: polyconv [-f64] input.txt output.pdb\n"
+                    "       polyconv [-j threads] [-c cache] [-s socket] [-t tolerance] [-a | -A]\n"
+                    "                [-M] [-q] -d input pieces\n"
+                    "       polyconv -m budget_mb -d input.pdb pieces.pdb\n"
+                    "input is .txt, .pdb, .wkt or .geojson/.json, pieces are .pdb, .wkt or "
+                    ".geojson/.json\n");
+    return 2;
+}
+
+static bool hasSuffix(const char *path, const char *suffix) {
+    size_t n = strlen(path), m = strlen(suffix);
+    return n >= m && strcasecmp(path + n - m, suffix) == 0;
+}
+
+static bool isGeoJSON(const char *path) {
+    return hasSuffix(path, ".geojson") || hasSuffix(path, ".json");
+}
+
+// copies the rings of polygon p out of a binary file
+static void loadRings(const PolyFile &file, size_t p, Rings &rings) {
+    rings.resize(file.ringCount(p));
+    for (size_t i = 0; i < rings.size(); ++i) {
+        size_t r = file.firstRing(p) + i;
+        rings[i].clear();
+        if (file.doubles()) {
+            for (const DoublePoint &q : file.ring<DoublePoint>(r)) {
+                rings[i].push_back(Point(q.x, q.y));
+            }
+        } else {
+            RingView<Point> ring = file.ring<Point>(r);
+            rings[i].assign(ring.begin(), ring.end());
+        }
+    }
+}
+
+// hands every polygon of a file to the callback, whatever its format, with
+// its feature index (the polygon's own index in .txt and .pdb files); with a
+// tolerance the rings of each polygon are simplified together first, adding
+// the vertices that drops to removed
+static bool readPolygons(const char *path, Scalar tolerance, size_t &removed,
+                         const PolygonCallback &callback, string &error) {
+    if (tolerance > 0) {
+        return readPolygons(path, 0, removed, [&](Rings &rings, size_t feature) {
+            removed += simplifyPoly(rings, tolerance);
+            callback(rings, feature);
+        }, error);
+    }
+    if (hasSuffix(path, ".wkt")) {
+        return readWKT(path, callback, error);
+    }
+    if (isGeoJSON(path)) {
+        return readGeoJSON(path, callback, error);
+    }
+
+    Rings rings;
+    if (hasSuffix(path, ".pdb")) {
+        PolyFile file(path);
+        for (size_t p = 0; p < file.polygons(); ++p) {
+            loadRings(file, p, rings);
+            callback(rings, p);
+        }
+        error = file.error();
+        return file.ok();
+    }
+
+    PolygonReader reader(path);
+    rings.resize(1);
+    for (size_t p = 0; reader.next(rings[0]); ++p) {
+        callback(rings, p);
+        rings.resize(1);
+    }
+    error = reader.error();
+    return reader.ok();
+}
+
+// sends every polygon of the input to a polydecomp_server, keeping a window
+// of jobs in flight, and hands the results to the sink in input order after
+// queueing each polygon's feature index on features; pieces are merged here
+// as the server does not
+static bool decomposeRemote(const char *in, Scalar tolerance, size_t &simplified,
+                            deque<size_t> &features, const char *socketPath, bool merge,
+                            const BatchStream::Sink &sink, string &error) {
+    const size_t window = 256;
+    DecompositionClient client(socketPath);
+    deque<Rings> inFlight;
+    uint32_t sent = 0;
+    Decomposition result;
+    auto receive = [&]() {
+        uint32_t id;
+        if (!client.receive(id, result)) {
+            return false;
+        }
+        expandPieces(inFlight.front(), result);
+        if (merge) {
+            result.merged = mergePolygons(result.polys);
+        }
+        sink(inFlight.front(), result);
+        inFlight.pop_front();
+        return true;
+    };
+    auto send = [&](Rings &rings, size_t feature) {
+        if (!client.send(sent++, rings)) {
+            return;
+        }
+        features.push_back(feature);
+        inFlight.emplace_back();
+        inFlight.back().swap(rings);
+        if (inFlight.size() > window) {
+            receive();
+        }
+    };
+    bool ok = client.ok() && readPolygons(in, tolerance, simplified, send, error);
+    while (client.ok() && !inFlight.empty()) {
+        receive();
+    }
+    if (ok && !client.ok()) {
+        error = string(socketPath) + ": " + client.error();
+        ok = false;
+    }
+    return ok;
+}
+
+// decomposes every polygon of the input in batches on all cores, streaming
+// the pieces to the output as each batch completes; very large outlines are
+// tiled instead
+static int decomposeFile(const char *in, const char *out, Scalar tolerance, unsigned threads,
+                         const char *cachePath, const char *socketPath, bool routed,
+                         bool calibrate, bool merge, bool quality) {
+    unique_ptr<PolyFileWriter> binary;
+    unique_ptr<GISWriter> text;
+    if (hasSuffix(out, ".pdb")) {
+        binary.reset(new PolyFileWriter(out));
+    } else {
+        text.reset(new GISWriter(out, hasSuffix(out, ".wkt") ? GISWriter::WKT : GISWriter::GeoJSON));
+    }
+
+    Engine engine(threads);
+    unique_ptr<DecompositionCache> cache;
+    if (cachePath) {
+        cache.reset(new DecompositionCache(size_t(256) << 20, cachePath));
+        if (!cache->ok()) {
+            fprintf(stderr, "%s\n", cache->error().c_str());
+        }
+        engine.setCache(cache.get());
+    }
+    // -a routes by the predicted cost of each algorithm, -A by costs
+    // measured on this machine first
+    CostModel model;
+    if (calibrate) {
+        model.calibrate();
+        fprintf(stderr,
+                "cost model: %.4g us per vertex, %.4g per bayazit step, %.4g per split, "
+                "%.4g per earcut step\n",
+                model.perVertex, model.perBayazitStep, model.perBayazitSplit,
+                model.perEarcutStep);
+    }
+    RoutingPolicy policy;
+    policy.model = &model;
+    if (routed || calibrate) {
+        engine.setRouting(&policy);
+    }
+    string error;
+    bool ok;
+    int output = Decomposition::Polygons | (merge ? Decomposition::Merged : 0);
+    size_t pieces = 0, merged = 0, simplified = 0;
+    DecompositionMetrics metrics;
+    // with -q the pieces are also kept in a resident store to report what
+    // holding them in memory costs
+    PieceStore store;
+    size_t copies = 0;
+    Polygon outline;
+    // feature index of every polygon read but not yet written, as results
+    // arrive in input order
+    deque<size_t> features;
+    BatchStream::Sink write = [&](const Rings &input, const Decomposition &result) {
+        pieces += result.polys.size();
+        merged += result.merged;
+        if (quality) {
+            metrics.add(measure(input, result));
+            outline.clear();
+            for (const Polygon &ring : input) {
+                outline.insert(outline.end(), ring.begin(), ring.end());
+            }
+            store.add(outline, result);
+            for (const Polygon &piece : result.polys) {
+                copies += piece.size() * sizeof(Point);
+            }
+        }
+        if (binary) {
+            for (const Polygon &piece : result.polys) {
+                binary->writePolygon(piece);
+            }
+        } else {
+            text->write(result.polys, features.front());
+        }
+        features.pop_front();
+    };
+    if (socketPath) {
+        ok = decomposeRemote(in, tolerance, simplified, features, socketPath, merge, write,
+                             error);
+    } else {
+        // outlines this large would hold up one worker for the whole batch,
+        // so they are tiled over every core on their own
+        const size_t tiledVertices = 1 << 16;
+        BatchStream stream(engine, write, 4096, output);
+        ok = readPolygons(in, tolerance, simplified, [&](Rings &rings, size_t feature) {
+            features.push_back(feature);
+            if (rings.size() == 1 && rings[0].size() >= tiledVertices) {
+                stream.flush();
+                Decomposition result;
+                result.output = output;
+                decomposeTiled(rings[0], result, engine);
+                write(rings, result);
+            } else {
+                stream.push(rings);
+            }
+        }, error);
+    }
+
+    bool written = binary ? binary->finish() : text->finish();
+    if (ok && !written) {
+        error = string(out) + ": " + (binary ? binary->error() : text->error());
+        ok = false;
+    }
+    if (cache) {
+        DecompositionCache::Stats stats = cache->stats();
+        fprintf(stderr, "cache: %llu hits, %llu from disk, %llu misses (%.1f%%)\n",
+                (unsigned long long) stats.hits, (unsigned long long) stats.diskHits,
+                (unsigned long long) stats.misses, stats.hitRate() * 100);
+    }
+    if (routed || calibrate) {
+        fprintf(stderr, "routes:");
+        for (Algorithm algorithm : {Algorithm::Passthrough, Algorithm::SingleSplit,
+                                    Algorithm::Bayazit, Algorithm::Earcut}) {
+            fprintf(stderr, " %llu %s", (unsigned long long) engine.routed(algorithm),
+                    algorithmName(algorithm));
+        }
+        fprintf(stderr, "\n");
+    }
+    if (tolerance > 0) {
+        fprintf(stderr, "simplified: %zu vertices removed\n", simplified);
+    }
+    if (merge) {
+        fprintf(stderr, "merged: %zu pieces into %zu\n", pieces + merged, pieces);
+    }
+    if (quality) {
+        fprintf(stderr,
+                "quality: %zu pieces, %zu Steiner points, min angle %.2f, aspect %.2f mean "
+                "%.2f max, diagonals %.6g long, %zu slivers (%.1f%%)\n",
+                metrics.pieces, metrics.steinerPoints, metrics.minAngle, metrics.meanAspect,
+                metrics.maxAspect, metrics.diagonalLength, metrics.slivers,
+                metrics.sliverScore() * 100);
+        store.shrinkToFit();
+        fprintf(stderr, "store: %zu pieces in %.1f MB, %.1f MB as copies\n", store.pieces(),
+                store.memoryUsage() / 1048576.0, copies / 1048576.0);
+    }
+    if (!ok) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+// decomposes polygons of any size within a memory budget: outlines are cut
+// into tiles through temporary files and pieces go straight to the output
+static int decomposeOutOfCore(const char *in, const char *out, size_t budget) {
+    if (!hasSuffix(in, ".pdb") || !hasSuffix(out, ".pdb")) {
+        fprintf(stderr, "out-of-core decomposition reads and writes .pdb files\n");
+        return 2;
+    }
+    PolyFile file(in);
+    PolyFileWriter writer(out);
+    OutOfCoreDecomposer decomposer(budget);
+    auto write = [&](const Polygon &piece) { writer.writePolygon(piece); };
+    bool ok = file.ok() && writer.ok();
+    for (size_t p = 0; ok && p < file.polygons(); ++p) {
+        if (file.ringCount(p) > 1) {
+            // holes go to earcut, which needs the polygon in memory
+            Rings rings;
+            loadRings(file, p, rings);
+            Decomposition pieces;
+            pieces.output = 0;
+            pieces.sink = write;
+            decomposeRings(rings, pieces);
+        } else if (file.doubles()) {
+            RingView<DoublePoint> ring = file.ring<DoublePoint>(file.firstRing(p));
+            ok = decomposer.decompose(ring.data(), ring.size(), write);
+        } else {
+            RingView<Point> ring = file.ring<Point>(file.firstRing(p));
+            ok = decomposer.decompose(ring.data(), ring.size(), write);
+        }
+    }
+    ok = writer.finish() && ok;
+    if (!ok) {
+        fprintf(stderr, "%s\n", !file.ok()       ? file.error().c_str()
+                                : !decomposer.ok() ? decomposer.error().c_str()
+                                                   : (string(out) + ": " + writer.error()).c_str());
+        return 1;
+    }
+    fprintf(stderr, "%zu tiles from %zu cuts\n", decomposer.tiles(), decomposer.cuts());
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    unsigned threads = 0;
+    const char *cachePath = nullptr, *socketPath = nullptr;
+    size_t budget = 0;
+    Scalar tolerance = 0;
+    bool routed = false, calibrate = false, merge = false, quality = false;
+    while (argc > 4 && (strcmp(argv[1], "-j") == 0 || strcmp(argv[1], "-c") == 0 ||
+                        strcmp(argv[1], "-s") == 0 || strcmp(argv[1], "-m") == 0 ||
+                        strcmp(argv[1], "-t") == 0 ||
+                        strcmp(argv[1], "-a") == 0 || strcmp(argv[1], "-A") == 0 ||
+                        strcmp(argv[1], "-M") == 0 || strcmp(argv[1], "-q") == 0)) {
+        char flag = argv[1][1];
+        if (flag == 'a' || flag == 'A' || flag == 'M' || flag == 'q') {
+            (flag == 'a' ? routed : flag == 'A' ? calibrate : flag == 'M' ? merge : quality) =
+                true;
+            --argc;
+            ++argv;
+            continue;
+        }
+        if (flag == 'j') {
+            threads = atoi(argv[2]);
+        } else if (flag == 'c') {
+            cachePath = argv[2];
+        } else if (flag == 'm') {
+            budget = size_t(atof(argv[2]) * (1 << 20));
+        } else if (flag == 't') {
+            tolerance = atof(argv[2]);
+        } else {
+            socketPath = argv[2];
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc == 4 && strcmp(argv[1], "-d") == 0 && budget) {
+        return decomposeOutOfCore(argv[2], argv[3], budget);
+    }
+    if (argc == 4 && strcmp(argv[1], "-d") == 0) {
+        return decomposeFile(argv[2], argv[3], tolerance, threads, cachePath, socketPath,
+                             routed, calibrate, merge, quality);
+    }
+    bool doubles = argc == 4 && strcmp(argv[1], "-f64") == 0;
+    if (argc != 3 && !doubles) {
+        return usage();
+    }
+    string error;
+    if (!convertText(argv[argc - 2], argv[argc - 1], error, doubles)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
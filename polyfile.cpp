@@ -0,0 +1,238 @@
+#include "polyfile.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include "reader.hpp"
+
+static_assert(sizeof(Point) == 2 * sizeof(float) && sizeof(Scalar) == sizeof(float),
+              "float polygon files are read in place as Point");
+static_assert(sizeof(PolyFileHeader) % 8 == 0, "sections are 8-byte aligned");
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+// whether the count + 1 offsets of a table start at 0, never decrease and
+// end at limit, so every range they give is in bounds; strict also rejects
+// empty ranges
+static bool monotonic(const char *table, uint64_t count, uint64_t limit, bool strict = false) {
+    const uint64_t *offsets = reinterpret_cast<const uint64_t *>(table);
+    if (offsets[0] != 0 || offsets[count] != limit) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        if (offsets[i] > offsets[i + 1] || (strict && offsets[i] == offsets[i + 1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+PolyFile::PolyFile(const char *path) : file(path), err(file.error()) {
+    if (!ok()) {
+        return;
+    }
+    size_t length = file.size();
+    const char *data = file.data();
+    if (length < sizeof(PolyFileHeader)) {
+        err = string(path) + ": not a polygon file";
+        return;
+    }
+
+    const PolyFileHeader *h = reinterpret_cast<const PolyFileHeader *>(data);
+    size_t pointSize = (h->flags & polyFileDouble) ? 2 * sizeof(double) : 2 * sizeof(float);
+    if (memcmp(h->magic, polyFileMagic, 4) != 0 || h->version != polyFileVersion) {
+        err = string(path) + ": not a polygon file";
+    } else if (h->ringTable % 8 || h->polygonTable % 8 || h->ringTable > length ||
+               h->polygonTable > length || h->pointCount > length / pointSize ||
+               h->ringCount >= length / 8 || h->polygonCount >= length / 8 ||
+               sizeof(PolyFileHeader) + h->pointCount * pointSize > h->ringTable ||
+               h->ringTable + (h->ringCount + 1) * 8 > h->polygonTable ||
+               h->polygonTable + (h->polygonCount + 1) * 8 > length ||
+               !monotonic(data + h->ringTable, h->ringCount, h->pointCount) ||
+               // every polygon has at least its outline
+               !monotonic(data + h->polygonTable, h->polygonCount, h->ringCount, true)) {
+        err = string(path) + ": truncated or corrupt polygon file";
+    }
+    if (!ok()) {
+        return;
+    }
+    header = h;
+    coords = data + sizeof(PolyFileHeader);
+    ringTable = reinterpret_cast<const uint64_t *>(data + h->ringTable);
+    polygonTable = reinterpret_cast<const uint64_t *>(data + h->polygonTable);
+}
+
+Polygon PolyFile::outline(size_t p) const {
+    size_t r = firstRing(p);
+    if (!doubles()) {
+        RingView<Point> view = ring<Point>(r);
+        return Polygon(view.begin(), view.end());
+    }
+    Polygon poly;
+    for (const DoublePoint &q : ring<DoublePoint>(r)) {
+        poly.push_back(Point(q.x, q.y));
+    }
+    return poly;
+}
+
+// table entries kept in memory before they move to the temporary file
+static const size_t spillSize = size_t(1) << 20;
+
+SpillTable::~SpillTable() {
+    if (spill) {
+        fclose(spill);
+    }
+}
+
+bool SpillTable::push_back(uint64_t value) {
+    recent.push_back(value);
+    if (recent.size() < spillSize) {
+        return true;
+    }
+    if (!spill && !(spill = tmpfile())) {
+        return false;
+    }
+    bool ok = fwrite(recent.data(), 8, recent.size(), spill) == recent.size();
+    spilled += recent.size();
+    recent.clear();
+    return ok;
+}
+
+bool SpillTable::writeTo(FILE *out) {
+    if (spill) {
+        rewind(spill);
+        char chunk[1 << 16];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), spill)) > 0) {
+            if (fwrite(chunk, 1, n, out) != n) {
+                return false;
+            }
+        }
+        if (ferror(spill)) {
+            return false;
+        }
+    }
+    return fwrite(recent.data(), 8, recent.size(), out) == recent.size();
+}
+
+PolyFileWriter::PolyFileWriter(const char *path, bool doubles) : doubles(doubles) {
+    file = fopen(path, "wb");
+    if (!file) {
+        err = string(path) + ": " + strerror(errno);
+        return;
+    }
+    PolyFileHeader header = {};
+    write(&header, sizeof(header));
+}
+
+PolyFileWriter::~PolyFileWriter() {
+    if (file) {
+        finish();
+    }
+}
+
+void PolyFileWriter::write(const void *bytes, size_t size) {
+    if (ok() && fwrite(bytes, 1, size, file) != size) {
+        err = strerror(errno);
+    }
+}
+
+void PolyFileWriter::append(SpillTable &table, uint64_t value) {
+    if (!table.push_back(value) && ok()) {
+        err = string("temporary table file: ") + strerror(errno);
+    }
+}
+
+void PolyFileWriter::beginPolygon() {
+    append(polygonTable, ringTable.size());
+}
+
+void PolyFileWriter::addRing(const Point *points, size_t count) {
+    append(ringTable, pointCount);
+    pointCount += count;
+    if (!doubles) {
+        write(points, count * sizeof(Point));
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        DoublePoint q = {points[i].x, points[i].y};
+        write(&q, sizeof(q));
+    }
+}
+
+void PolyFileWriter::addRing(const DoublePoint *points, size_t count) {
+    append(ringTable, pointCount);
+    pointCount += count;
+    if (doubles) {
+        write(points, count * sizeof(DoublePoint));
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        Point q(points[i].x, points[i].y);
+        write(&q, sizeof(q));
+    }
+}
+
+void PolyFileWriter::writePolygon(const Polygon &outline) {
+    beginPolygon();
+    addRing(outline.data(), outline.size());
+}
+
+void PolyFileWriter::writePolygon(const vector<Polygon> &rings) {
+    if (rings.empty()) {
+        return;
+    }
+    beginPolygon();
+    for (const Polygon &ring : rings) {
+        addRing(ring.data(), ring.size());
+    }
+}
+
+bool PolyFileWriter::finish() {
+    if (!file) {
+        return ok();
+    }
+    PolyFileHeader header = {};
+    memcpy(header.magic, polyFileMagic, 4);
+    header.version = polyFileVersion;
+    header.flags = doubles ? polyFileDouble : 0;
+    header.polygonCount = polygonTable.size();
+    header.ringCount = ringTable.size();
+    header.pointCount = pointCount;
+
+    size_t end = sizeof(header) + pointCount * (doubles ? sizeof(DoublePoint) : sizeof(Point));
+    static const char padding[8] = {};
+    write(padding, align8(end) - end);
+    header.ringTable = align8(end);
+    header.polygonTable = header.ringTable + (ringTable.size() + 1) * 8;
+
+    append(ringTable, pointCount);
+    append(polygonTable, ringTable.size() - 1);
+    if (ok() && (!ringTable.writeTo(file) || !polygonTable.writeTo(file))) {
+        err = strerror(errno);
+    }
+
+    if (ok() && fseek(file, 0, SEEK_SET) != 0) {
+        err = strerror(errno);
+    }
+    write(&header, sizeof(header));
+    if (fclose(file) != 0 && ok()) {
+        err = strerror(errno);
+    }
+    file = nullptr;
+    return ok();
+}
+
+bool convertText(const char *textPath, const char *binaryPath, string &error, bool doubles) {
+    PolygonReader reader(textPath);
+    PolyFileWriter writer(binaryPath, doubles);
+    Polygon poly;
+    while (reader.next(poly) && writer.ok()) {
+        writer.writePolygon(poly);
+    }
+    writer.finish();
+    error = !reader.ok() ? reader.error() : writer.error();
+    return reader.ok() && writer.ok();
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include <earcut.hpp>
+
+#include "mapped.hpp"
+#include "point.hpp"
+
+// Binary polygon container. All fields are little-endian and every section
+// starts on an 8-byte boundary:
+//
+//   PolyFileHeader
+//   coordinates    x, y pairs of every ring, as float or double
+//   ring table     uint64_t first point of each ring, then the point count
+//   polygon table  uint64_t first ring of each polygon, then the ring count
+//
+// The first ring of a polygon is its outline, any further rings are holes.
+// Every polygon has an outline; files with a polygon of no rings are
+// rejected as corrupt.
+// Decomposition output is written the same way, one polygon per piece.
+struct PolyFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t polygonCount, ringCount, pointCount;
+    uint64_t ringTable, polygonTable;
+};
+
+static const char polyFileMagic[4] = {'P', 'D', 'C', 'B'};
+static const uint32_t polyFileVersion = 1;
+static const uint32_t polyFileDouble = 1;
+
+struct DoublePoint {
+    double x, y;
+};
+
+namespace mapbox {
+namespace util {
+template <> struct nth<0, DoublePoint> {
+    static double get(const DoublePoint &t) { return t.x; };
+};
+
+template <> struct nth<1, DoublePoint> {
+    static double get(const DoublePoint &t) { return t.y; };
+};
+} // namespace util
+} // namespace mapbox
+
+// Read-only view of one ring inside a mapped file, usable as an earcut ring.
+template <class T> class RingView {
+public:
+    typedef T value_type;
+
+    RingView(const T *points = nullptr, size_t count = 0) : points(points), count(count) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T &operator[](size_t i) const { return points[i]; }
+    const T *data() const { return points; }
+    const T *begin() const { return points; }
+    const T *end() const { return points + count; }
+
+private:
+    const T *points;
+    size_t count;
+};
+
+class PolyFile;
+
+// The rings of one polygon, usable as an earcut polygon.
+template <class T> class PolygonView {
+public:
+    typedef RingView<T> value_type;
+
+    PolygonView(const PolyFile &file, size_t firstRing, size_t count)
+        : file(file), firstRing(firstRing), count(count) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    RingView<T> operator[](size_t i) const;
+
+private:
+    const PolyFile &file;
+    size_t firstRing, count;
+};
+
+// Memory-mapped binary polygon file. Rings are handed out as views into the
+// mapping, nothing is copied. Float files expose rings of Point, which the
+// decomposer and earcut read directly; double files expose DoublePoint.
+class PolyFile {
+public:
+    PolyFile(const char *path);
+
+    bool ok() const { return err.empty(); }
+    const string &error() const { return err; }
+    bool doubles() const { return header && (header->flags & polyFileDouble); }
+
+    size_t polygons() const { return header ? header->polygonCount : 0; }
+    size_t rings() const { return header ? header->ringCount : 0; }
+    size_t points() const { return header ? header->pointCount : 0; }
+
+    size_t firstRing(size_t polygon) const { return polygonTable[polygon]; }
+    size_t ringCount(size_t polygon) const {
+        return polygonTable[polygon + 1] - polygonTable[polygon];
+    }
+    size_t firstPoint(size_t ring) const { return ringTable[ring]; }
+    size_t pointCount(size_t ring) const { return ringTable[ring + 1] - ringTable[ring]; }
+
+    template <class T> RingView<T> ring(size_t r) const {
+        return RingView<T>(static_cast<const T *>(coords) + ringTable[r], pointCount(r));
+    }
+    template <class T> PolygonView<T> polygon(size_t p) const {
+        return PolygonView<T>(*this, firstRing(p), ringCount(p));
+    }
+
+    // outline of a polygon as Point, converting only for double files
+    Polygon outline(size_t p) const;
+
+private:
+    MappedFile file;
+    const PolyFileHeader *header = nullptr;
+    const void *coords = nullptr;
+    const uint64_t *ringTable = nullptr, *polygonTable = nullptr;
+    string err;
+};
+
+template <class T> RingView<T> PolygonView<T>::operator[](size_t i) const {
+    return file.ring<T>(firstRing + i);
+}
+
+// Table of uint64_t that moves to a temporary file once it outgrows a few
+// MiB, so writing many millions of rings takes bounded memory.
+class SpillTable {
+public:
+    SpillTable() {}
+    ~SpillTable();
+
+    SpillTable(const SpillTable &) = delete;
+    SpillTable &operator=(const SpillTable &) = delete;
+
+    uint64_t size() const { return spilled + recent.size(); }
+    // false if the temporary file failed
+    bool push_back(uint64_t value);
+    // copies the whole table to out
+    bool writeTo(FILE *out);
+
+private:
+    vector<uint64_t> recent;
+    FILE *spill = nullptr;
+    uint64_t spilled = 0;
+};
+
+// Streams polygons into a binary file. Coordinates go straight to disk; the
+// ring and polygon tables are kept until finish(), in memory at first and
+// in temporary files when they grow large.
+class PolyFileWriter {
+public:
+    PolyFileWriter(const char *path, bool doubles = false);
+    ~PolyFileWriter();
+
+    PolyFileWriter(const PolyFileWriter &) = delete;
+    PolyFileWriter &operator=(const PolyFileWriter &) = delete;
+
+    bool ok() const { return err.empty(); }
+    const string &error() const { return err; }
+
+    // adds a ring to the polygon started by the last beginPolygon(), which
+    // needs at least one
+    void beginPolygon();
+    void addRing(const Point *points, size_t count);
+    void addRing(const DoublePoint *points, size_t count);
+
+    void writePolygon(const Polygon &outline);
+    // writes nothing for no rings
+    void writePolygon(const vector<Polygon> &rings);
+
+    // writes the tables and the header; called by the destructor if needed
+    bool finish();
+
+private:
+    FILE *file = nullptr;
+    bool doubles;
+    uint64_t pointCount = 0;
+    SpillTable ringTable, polygonTable;
+    string err;
+
+    void write(const void *bytes, size_t size);
+    void append(SpillTable &table, uint64_t value);
+};
+
+// Converts a text polygon file (see PolygonReader) to the binary format.
+bool convertText(const char *textPath, const char *binaryPath, string &error,
+                 bool doubles = false);
@@ -0,0 +1,163 @@
+#include "protocol.hpp"
+
+#include <cstring>
+
+namespace {
+
+// Sequential reader that fails instead of running past the end.
+class Cursor {
+public:
+    Cursor(const char *data, size_t size) : p(data), end(data + size) {}
+
+    bool word(uint32_t &v) { return bytes(&v, sizeof(v)); }
+    bool bytes(void *out, size_t n) {
+        if (size_t(end - p) < n) {
+            return false;
+        }
+        memcpy(out, p, n);
+        p += n;
+        return true;
+    }
+    size_t left() const { return end - p; }
+    const char *position() const { return p; }
+
+private:
+    const char *p, *end;
+};
+
+char *put(char *out, const void *data, size_t n) {
+    memcpy(out, data, n);
+    return out + n;
+}
+
+char *putWord(char *out, uint32_t v) {
+    return put(out, &v, sizeof(v));
+}
+
+} // namespace
+
+size_t jobSize(const Rings &rings) {
+    size_t points = 0;
+    for (const Polygon &ring : rings) {
+        points += ring.size();
+    }
+    return (2 + rings.size()) * sizeof(uint32_t) + points * sizeof(Point);
+}
+
+void encodeJob(uint32_t id, const Rings &rings, char *out) {
+    out = putWord(out, id);
+    out = putWord(out, rings.size());
+    for (const Polygon &ring : rings) {
+        out = putWord(out, ring.size());
+    }
+    for (const Polygon &ring : rings) {
+        out = put(out, ring.data(), ring.size() * sizeof(Point));
+    }
+}
+
+bool decodeJob(const char *data, size_t size, uint32_t &id, Rings &rings) {
+    Cursor in(data, size);
+    uint32_t count;
+    if (!in.word(id) || !in.word(count) || count > in.left() / sizeof(uint32_t)) {
+        return false;
+    }
+    // every count is checked against the payload before anything is
+    // allocated for it
+    vector<uint32_t> counts(count);
+    size_t points = 0;
+    for (uint32_t &n : counts) {
+        if (!in.word(n)) {
+            return false;
+        }
+        points += n;
+        if (points > in.left() / sizeof(Point)) {
+            return false;
+        }
+    }
+    if (points * sizeof(Point) != in.left()) {
+        return false;
+    }
+    rings.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        rings[i].resize(counts[i]);
+        in.bytes(rings[i].data(), counts[i] * sizeof(Point));
+    }
+    return true;
+}
+
+size_t resultSize(const Decomposition &result) {
+    size_t pieces = result.firstIndex.empty() ? 0 : result.firstIndex.size() - 1;
+    return (5 + pieces + 1 + result.indices.size()) * sizeof(uint32_t) +
+           result.steinerPoints.size() * sizeof(Point);
+}
+
+void encodeResult(uint32_t id, JobStatus status, const Decomposition &result, char *out) {
+    uint32_t pieces = result.firstIndex.empty() ? 0 : result.firstIndex.size() - 1;
+    out = putWord(out, id);
+    out = putWord(out, status);
+    out = putWord(out, pieces);
+    out = putWord(out, result.indices.size());
+    out = putWord(out, result.steinerPoints.size());
+    if (result.firstIndex.empty()) {
+        out = putWord(out, 0);
+    } else {
+        out = put(out, result.firstIndex.data(), result.firstIndex.size() * sizeof(uint32_t));
+    }
+    out = put(out, result.indices.data(), result.indices.size() * sizeof(uint32_t));
+    put(out, result.steinerPoints.data(), result.steinerPoints.size() * sizeof(Point));
+}
+
+bool viewResult(const char *data, size_t size, ResultView &view) {
+    Cursor in(data, size);
+    uint32_t status;
+    if (!in.word(view.id) || !in.word(status) || !in.word(view.pieces) ||
+        !in.word(view.indexCount) || !in.word(view.steinerCount) ||
+        (size_t(view.pieces) + 1 + view.indexCount) * sizeof(uint32_t) +
+                size_t(view.steinerCount) * sizeof(Point) !=
+            in.left()) {
+        return false;
+    }
+    view.status = JobStatus(status);
+    view.firstIndex = (const uint32_t *) in.position();
+    view.indices = view.firstIndex + view.pieces + 1;
+    view.steinerPoints = (const Point *) (view.indices + view.indexCount);
+    return true;
+}
+
+void copyResult(const ResultView &view, Decomposition &result) {
+    result.clear();
+    result.output = Decomposition::Indices;
+    result.firstIndex.assign(view.firstIndex, view.firstIndex + view.pieces + 1);
+    result.indices.assign(view.indices, view.indices + view.indexCount);
+    result.steinerPoints.assign(view.steinerPoints, view.steinerPoints + view.steinerCount);
+}
+
+bool decodeResult(const char *data, size_t size, uint32_t &id, JobStatus &status,
+                  Decomposition &result) {
+    ResultView view;
+    if (!viewResult(data, size, view)) {
+        return false;
+    }
+    id = view.id;
+    status = view.status;
+    copyResult(view, result);
+    return true;
+}
+
+void expandPieces(const Rings &rings, Decomposition &result) {
+    vector<Point> verts;
+    for (const Polygon &ring : rings) {
+        verts.insert(verts.end(), ring.begin(), ring.end());
+    }
+    result.polys.clear();
+    for (size_t i = 0; i + 1 < result.firstIndex.size(); ++i) {
+        Polygon piece;
+        for (uint32_t k = result.firstIndex[i]; k < result.firstIndex[i + 1]; ++k) {
+            uint32_t id = result.indices[k];
+            piece.push_back(id < verts.size() ? verts[id]
+                                              : result.steinerPoints[id - verts.size()]);
+        }
+        result.polys.push_back(piece);
+    }
+    result.output |= Decomposition::Polygons;
+}
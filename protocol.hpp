@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+#include "decomp.hpp"
+
+// Wire format of decomposition jobs, shared by the socket service and the
+// shared-memory transport. Fields are native-endian 32-bit words, the peers
+// run on one machine.
+//
+//   job:    id, ring count, point count of every ring, x y of every point
+//   result: id, status, piece count, index count, Steiner point count,
+//           firstIndex (piece count + 1 entries), indices, x y of every
+//           Steiner point
+//
+// Results are indexed (see Decomposition): ids address the points of the
+// job's rings one after another, followed by the Steiner points.
+enum JobStatus : uint32_t { jobDone = 0, jobMalformed = 1, jobTooLarge = 2 };
+
+size_t jobSize(const Rings &rings);
+// out must have room for jobSize(rings) bytes
+void encodeJob(uint32_t id, const Rings &rings, char *out);
+bool decodeJob(const char *data, size_t size, uint32_t &id, Rings &rings);
+
+// A result read in place, pointing into the buffer it was decoded from.
+struct ResultView {
+    uint32_t id;
+    JobStatus status;
+    uint32_t pieces, indexCount, steinerCount;
+    const uint32_t *firstIndex; // pieces + 1 entries
+    const uint32_t *indices;
+    const Point *steinerPoints;
+};
+
+size_t resultSize(const Decomposition &result);
+void encodeResult(uint32_t id, JobStatus status, const Decomposition &result, char *out);
+bool viewResult(const char *data, size_t size, ResultView &view);
+void copyResult(const ResultView &view, Decomposition &result);
+bool decodeResult(const char *data, size_t size, uint32_t &id, JobStatus &status,
+                  Decomposition &result);
+
+// Fills result.polys from the indexed pieces and the job's rings.
+void expandPieces(const Rings &rings, Decomposition &result);
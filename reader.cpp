@@ -0,0 +1,216 @@
+#include "reader.hpp"
+
+#include <cstring>
+
+static const double powersOf10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                    1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+static const double negPowersOf10[] = {1e-0,  1e-1,  1e-2,  1e-3,  1e-4,  1e-5,  1e-6,  1e-7,
+                                       1e-8,  1e-9,  1e-10, 1e-11, 1e-12, 1e-13, 1e-14, 1e-15,
+                                       1e-16, 1e-17, 1e-18, 1e-19, 1e-20, 1e-21, 1e-22};
+
+PolygonReader::PolygonReader(const char *path)
+    : file(path, true), begin(file.data()), cur(begin), end(file.end()), err(file.error()) {
+}
+
+void PolygonReader::fail(const char *what) {
+    err = "line " + to_string(lineNo) + ": " + what;
+}
+
+void PolygonReader::skipBlanks() {
+    while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\r')) {
+        ++cur;
+    }
+}
+
+static bool isDigit(char c) {
+    return unsigned(c - '0') < 10;
+}
+
+// reads an exponent after the digits and scales the mantissa by it
+static const char *finish(const char *p, const char *end, bool negative, uint64_t mantissa,
+                          int exponent, Scalar &v) {
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negativeExp = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negativeExp = *p++ == '-';
+        }
+        if (p == end || !isDigit(*p)) {
+            return nullptr;
+        }
+        int e = 0;
+        for (; p < end && isDigit(*p); ++p) {
+            e = e < 10000 ? e * 10 + (*p - '0') : e;
+        }
+        exponent += negativeExp ? -e : e;
+    }
+
+    double value = mantissa;
+    if (exponent < 0) {
+        value = -exponent <= 22 ? value * negPowersOf10[-exponent] : value * pow(10.0, exponent);
+    } else if (exponent > 0) {
+        value = exponent <= 22 ? value * powersOf10[exponent] : value * pow(10.0, exponent);
+    }
+    v = negative ? -value : value;
+    return p;
+}
+
+// up to 19 significant digits fit the mantissa, the rest only scale it
+static const char *parseLong(const char *p, const char *end, bool negative, Scalar &v) {
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    for (; p < end && isDigit(*p); ++p) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        } else {
+            ++exponent;
+        }
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        for (; p < end && isDigit(*p); ++p) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                --exponent;
+            }
+        }
+    }
+    return finish(p, end, negative, mantissa, exponent, v);
+}
+
+// Appends the run of digits at p to mantissa and returns its end. Eight
+// characters are looked at in one word while that many are left: the digits
+// among them are found by their bytes and summed pairwise.
+static inline const char *digitRun(const char *p, const char *end, uint64_t &mantissa) {
+    static const uint64_t scale[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000,
+                                     100000000};
+    while (end - p >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        // bytes 0-9 for digits; a carry only spoils bytes past a non-digit
+        uint64_t values = word ^ 0x3030303030303030;
+        uint64_t other = ((values + 0x7676767676767676) | values) & 0x8080808080808080;
+        int n = other ? __builtin_ctzll(other) / 8 : 8;
+        if (n == 0) {
+            return p;
+        }
+        // the first n digits, as the low end of an eight digit number
+        uint64_t x = values << (8 * (8 - n));
+        x = x * 10 + (x >> 8);
+        x = (((x & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) +
+             (((x >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >>
+            32;
+        mantissa = mantissa * scale[n] + uint32_t(x);
+        p += n;
+        if (n < 8) {
+            return p;
+        }
+    }
+    for (; p < end && isDigit(*p); ++p) {
+        mantissa = mantissa * 10 + (*p - '0');
+    }
+    return p;
+}
+
+const char *parseScalar(const char *p, const char *end, Scalar &v) {
+    // the sign is skipped without a branch, as it is hard to predict
+    char sign = p < end ? *p : 0;
+    bool negative = sign == '-';
+    p += negative | (sign == '+');
+
+    // Most numbers have at most 19 digits, which the mantissa holds
+    // exactly, so the digits are summed without counting them one by one.
+    const char *start = p;
+    uint64_t mantissa = 0;
+    p = digitRun(p, end, mantissa);
+    size_t digits = p - start;
+    int exponent = 0;
+    if (p < end && *p == '.') {
+        const char *fraction = ++p;
+        p = digitRun(p, end, mantissa);
+        exponent = -int(p - fraction);
+        digits += p - fraction;
+    }
+    if (digits == 0) {
+        return nullptr;
+    }
+    if (digits > 19) {
+        return parseLong(start, end, negative, v);
+    }
+    return finish(p, end, negative, mantissa, exponent, v);
+}
+
+bool PolygonReader::parseScalar(Scalar &v) {
+    const char *p = ::parseScalar(cur, end, v);
+    if (!p) {
+        fail("expected a number");
+        return false;
+    }
+    cur = p;
+    return true;
+}
+
+bool PolygonReader::parsePoint(Point &pt) {
+    ++cur; // '('
+    skipBlanks();
+    if (!parseScalar(pt.x)) {
+        return false;
+    }
+    skipBlanks();
+    if (cur == end || *cur != ',') {
+        fail("expected ',' between coordinates");
+        return false;
+    }
+    ++cur;
+    skipBlanks();
+    if (!parseScalar(pt.y)) {
+        return false;
+    }
+    skipBlanks();
+    if (cur == end || *cur != ')') {
+        fail("expected ')' after a point");
+        return false;
+    }
+    ++cur;
+    return true;
+}
+
+bool PolygonReader::next(Polygon &poly) {
+    poly.clear();
+    if (!ok()) {
+        return false;
+    }
+
+    int newlines = 0;
+    while (cur < end) {
+        char c = *cur;
+        if (c == '(') {
+            if (newlines >= 2 && !poly.empty()) {
+                break;
+            }
+            newlines = 0;
+            Point p;
+            if (!parsePoint(p)) {
+                poly.clear();
+                return false;
+            }
+            poly.push_back(p);
+        } else if (c == '\n') {
+            ++newlines;
+            ++lineNo;
+            ++cur;
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == ',') {
+            ++cur;
+        } else {
+            fail("unexpected character");
+            poly.clear();
+            return false;
+        }
+    }
+
+    file.release(cur);
+    return !poly.empty();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+#include "mapped.hpp"
+#include "point.hpp"
+
+// Streaming reader for text polygon files. Vertices are written as "(x, y)",
+// separated by whitespace or commas, and polygons are separated by blank
+// lines. The file is memory-mapped and parsed in place, one polygon per call
+// to next(), so memory use does not grow with the file size.
+class PolygonReader {
+public:
+    PolygonReader(const char *path);
+
+    // false once the file could not be opened or a parse error occurred
+    bool ok() const { return err.empty(); }
+    const string &error() const { return err; }
+
+    // reads the next polygon; false at the end of the file or on error
+    bool next(Polygon &poly);
+
+    size_t line() const { return lineNo; }
+    size_t bytesRead() const { return cur - begin; }
+
+private:
+    MappedFile file;
+    const char *begin, *cur, *end;
+    size_t lineNo = 1;
+    string err;
+
+    bool parsePoint(Point &p);
+    bool parseScalar(Scalar &v);
+    void skipBlanks();
+    void fail(const char *what);
+};
+
+// Parses a decimal floating point number starting at p without locale or
+// allocation. Returns the first character after it, or nullptr if p does not
+// start a number.
+const char *parseScalar(const char *p, const char *end, Scalar &v);
@@ -0,0 +1,434 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "protocol.hpp"
+#include "service.hpp"
+#include "shm.hpp"
+
+// frames above this are taken for garbage and end the connection
+static const uint32_t maxFrame = 1u << 30;
+
+static volatile sig_atomic_t quit = 0;
+
+static void stop(int) {
+    quit = 1;
+}
+
+static int usage() {
+    fprintf(stderr, "usage: polydecomp_server [-j threads] [-b batch] [-l latency_us] [-t limit_us] socket\n");
+    return 2;
+}
+
+// One client. The I/O thread owns the socket and the input buffer, the
+// dispatcher queues encoded results under the lock. A client that attached
+// shared memory sends its jobs and gets its results through the rings
+// instead, the socket then only tells when it goes away.
+struct Connection {
+    int fd;
+    vector<char> in;
+    vector<int> passed; // descriptors that came with the socket data
+    SharedRegion *region = nullptr;
+    size_t regionSize = 0;
+    SharedRing jobs, results;
+    int serverWake = -1, clientWake = -1;
+
+    mutex lock;
+    deque<vector<char>> out;
+    size_t sent = 0; // bytes of out.front() already written
+    bool closed = false;
+
+    explicit Connection(int fd) : fd(fd) {}
+    ~Connection() {
+        if (region) {
+            munmap(region, regionSize);
+        }
+        for (int f : passed) {
+            close(f);
+        }
+    }
+
+    // drops the client, replies still in the batcher find it closed
+    void shutdown() {
+        lock_guard<mutex> guard(lock);
+        closed = true;
+        out.clear();
+        for (int f : {fd, serverWake, clientWake}) {
+            if (f >= 0) {
+                close(f);
+            }
+        }
+    }
+
+    bool attach();
+};
+
+// Maps the shared memory passed with the handshake frame. The region is
+// checked before it is published under the lock, as replies may look at it
+// from the dispatcher thread at any time.
+bool Connection::attach() {
+    struct stat info;
+    if (region || passed.size() != 3 || fstat(passed[0], &info) != 0 ||
+        size_t(info.st_size) < SharedRegion::headerSize) {
+        return false;
+    }
+    size_t size = info.st_size;
+    void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, passed[0], 0);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+    SharedRegion *mapped = (SharedRegion *) base;
+    uint64_t ringSize = mapped->ringSize;
+    if (mapped->tag != SharedRegion::magic || mapped->version != 1 || ringSize % 8 ||
+        ringSize < 64 || SharedRegion::size(ringSize) != size) {
+        munmap(base, size);
+        return false;
+    }
+
+    lock_guard<mutex> guard(lock);
+    region = mapped;
+    regionSize = size;
+    jobs = SharedRing(&region->jobs, region->jobData(), ringSize);
+    results = SharedRing(&region->results, region->resultData(), ringSize);
+    close(passed[0]);
+    serverWake = passed[1];
+    clientWake = passed[2];
+    passed.clear();
+    return true;
+}
+
+// Accepts clients on a Unix domain socket and feeds their jobs to a batcher.
+// A single thread polls every socket; results are written without blocking
+// as the sockets drain.
+class Server {
+public:
+    Server(Batcher &batcher, int listener) : batcher(batcher), listener(listener) {
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+    ~Server() {
+        // replies still in the batcher find their connection closed
+        for (auto &connection : connections) {
+            connection->shutdown();
+        }
+        close(wakeFd);
+    }
+
+    void run();
+
+private:
+    Batcher &batcher;
+    int listener, wakeFd;
+    vector<shared_ptr<Connection>> connections;
+
+    void accept();
+    bool receive(Connection &connection);
+    bool flush(Connection &connection);
+    bool flushShared(Connection &connection);
+    bool drainJobs(const shared_ptr<Connection> &connection);
+    bool submitFrames(const shared_ptr<Connection> &connection);
+    void submit(const shared_ptr<Connection> &connection, const char *frame, uint32_t size);
+};
+
+void Server::run() {
+    vector<pollfd> fds;
+    // per connection its socket slot, and its wake slot or 0 if it has none
+    vector<size_t> slots, wakeSlots;
+    while (!quit) {
+        fds.assign(2, pollfd());
+        fds[0] = {listener, POLLIN, 0};
+        fds[1] = {wakeFd, POLLIN, 0};
+        slots.clear();
+        wakeSlots.clear();
+        for (auto &connection : connections) {
+            lock_guard<mutex> guard(connection->lock);
+            bool writing = !connection->out.empty() && !connection->region;
+            slots.push_back(fds.size());
+            fds.push_back({connection->fd, short(POLLIN | (writing ? POLLOUT : 0)), 0});
+            wakeSlots.push_back(connection->region ? fds.size() : 0);
+            if (connection->region) {
+                fds.push_back({connection->serverWake, POLLIN, 0});
+            }
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            return;
+        }
+        if (fds[1].revents) {
+            uint64_t count;
+            while (read(wakeFd, &count, sizeof(count)) > 0) {
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < connections.size(); ++i) {
+            shared_ptr<Connection> &connection = connections[i];
+            short events = fds[slots[i]].revents;
+            bool alive = !(events & (POLLERR | POLLNVAL));
+            if (alive && (events & (POLLIN | POLLHUP))) {
+                alive = receive(*connection) && submitFrames(connection);
+            }
+            // also drains results queued since the poll started; a client
+            // that attached in this round has no wake slot polled yet
+            if (alive && connection->region) {
+                if (wakeSlots[i] && fds[wakeSlots[i]].revents) {
+                    uint64_t count;
+                    while (read(connection->serverWake, &count, sizeof(count)) > 0) {
+                    }
+                }
+                alive = drainJobs(connection) && flushShared(*connection);
+            } else if (alive) {
+                alive = flush(*connection);
+            }
+            if (alive) {
+                connections[kept++] = connection;
+            } else {
+                connection->shutdown();
+            }
+        }
+        connections.resize(kept);
+
+        if (fds[0].revents & POLLIN) {
+            accept();
+        }
+    }
+}
+
+void Server::accept() {
+    int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd >= 0) {
+        connections.push_back(make_shared<Connection>(fd));
+    }
+}
+
+// appends what the socket has to the input buffer and keeps descriptors
+// passed along, false once the client is gone
+bool Server::receive(Connection &connection) {
+    char chunk[1 << 16];
+    alignas(cmsghdr) char control[CMSG_SPACE(8 * sizeof(int))];
+    for (;;) {
+        iovec data = {chunk, sizeof(chunk)};
+        msghdr message = {};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t n = recvmsg(connection.fd, &message, MSG_CMSG_CLOEXEC);
+        if (n > 0) {
+            for (cmsghdr *header = CMSG_FIRSTHDR(&message); header;
+                 header = CMSG_NXTHDR(&message, header)) {
+                if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+                    size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                    const int *fds = (const int *) CMSG_DATA(header);
+                    connection.passed.insert(connection.passed.end(), fds, fds + count);
+                }
+            }
+            connection.in.insert(connection.in.end(), chunk, chunk + n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+// submits every complete frame of the input buffer, false on a bogus frame
+bool Server::submitFrames(const shared_ptr<Connection> &connection) {
+    vector<char> &in = connection->in;
+    size_t offset = 0;
+    uint32_t size;
+    while (in.size() - offset >= sizeof(size)) {
+        memcpy(&size, in.data() + offset, sizeof(size));
+        if (size > maxFrame) {
+            return false;
+        }
+        if (in.size() - offset - sizeof(size) < size) {
+            break;
+        }
+        // an empty frame hands over shared memory
+        if (size == 0) {
+            if (!connection->attach()) {
+                return false;
+            }
+        } else {
+            submit(connection, in.data() + offset + sizeof(size), size);
+        }
+        offset += sizeof(size) + size;
+    }
+    in.erase(in.begin(), in.begin() + offset);
+    return true;
+}
+
+// writes queued results until the socket is full, false on a broken socket
+bool Server::flush(Connection &connection) {
+    lock_guard<mutex> guard(connection.lock);
+    while (!connection.out.empty()) {
+        const vector<char> &frame = connection.out.front();
+        ssize_t n = ::send(connection.fd, frame.data() + connection.sent,
+                           frame.size() - connection.sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        connection.sent += n;
+        if (connection.sent == frame.size()) {
+            connection.out.pop_front();
+            connection.sent = 0;
+        }
+    }
+    return true;
+}
+
+// submits the jobs waiting in the shared job ring, false on a corrupt ring
+bool Server::drainJobs(const shared_ptr<Connection> &connection) {
+    SharedRing &jobs = connection->jobs;
+    const char *record;
+    uint32_t size;
+    while ((record = jobs.peek(size))) {
+        submit(connection, record, size);
+        if (jobs.pop()) {
+            signalEvent(connection->clientWake);
+        }
+    }
+    return !jobs.broken();
+}
+
+// moves results that did not fit the result ring when they were done
+bool Server::flushShared(Connection &connection) {
+    lock_guard<mutex> guard(connection.lock);
+    while (!connection.out.empty()) {
+        const vector<char> &frame = connection.out.front();
+        uint32_t size = frame.size() - sizeof(uint32_t);
+        char *record = connection.results.reserve(size);
+        if (!record) {
+            break;
+        }
+        memcpy(record, frame.data() + sizeof(uint32_t), size);
+        if (connection.results.commit()) {
+            signalEvent(connection.clientWake);
+        }
+        connection.out.pop_front();
+    }
+    return true;
+}
+
+void Server::submit(const shared_ptr<Connection> &connection, const char *frame, uint32_t size) {
+    uint32_t id = 0;
+    Rings rings;
+    // malformed jobs still go through the batcher to keep results in order
+    JobStatus status = decodeJob(frame, size, id, rings) ? jobDone : jobMalformed;
+    if (status != jobDone) {
+        rings.clear();
+    }
+    int wake = wakeFd;
+    batcher.submit(rings, [connection, id, status, wake](const Rings &,
+                                                        const Decomposition &result) {
+        lock_guard<mutex> guard(connection->lock);
+        if (connection->closed) {
+            return;
+        }
+        const Decomposition *pieces = &result;
+        JobStatus state = status;
+        uint32_t size = resultSize(result);
+        static const Decomposition none;
+        if (connection->region && size > connection->results.maxRecord()) {
+            pieces = &none;
+            state = jobTooLarge;
+            size = resultSize(none);
+        }
+        // shared memory clients get the result encoded in place when the
+        // ring has room and nothing is queued ahead of it
+        char *record = nullptr;
+        if (connection->region && connection->out.empty()) {
+            record = connection->results.reserve(size);
+        }
+        if (record) {
+            encodeResult(id, state, *pieces, record);
+            if (connection->results.commit()) {
+                signalEvent(connection->clientWake);
+            }
+            return;
+        }
+        vector<char> frame(sizeof(size) + size);
+        memcpy(frame.data(), &size, sizeof(size));
+        encodeResult(id, state, *pieces, frame.data() + sizeof(size));
+        connection->out.push_back(move(frame));
+        signalEvent(wake);
+    });
+}
+
+int main(int argc, char **argv) {
+    unsigned threads = 0;
+    size_t batchSize = 256;
+    long latency = 500, timeLimit = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:b:l:t:")) != -1) {
+        switch (opt) {
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'b':
+            batchSize = atol(optarg);
+            break;
+        case 'l':
+            latency = atol(optarg);
+            break;
+        case 't':
+            timeLimit = atol(optarg);
+            break;
+        default:
+            return usage();
+        }
+    }
+    if (optind + 1 != argc) {
+        return usage();
+    }
+    const char *path = argv[optind];
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return 1;
+    }
+    strcpy(address.sun_path, path);
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (listener < 0 || bind(listener, (sockaddr *) &address, sizeof(address)) != 0 ||
+        listen(listener, 64) != 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction action = {};
+    action.sa_handler = stop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    Engine engine(threads);
+    // slow polygons come back as earcut triangles instead of holding up their batch
+    engine.setTimeLimit(chrono::microseconds(timeLimit));
+    {
+        Batcher batcher(engine, batchSize, chrono::microseconds(latency));
+        fprintf(stderr, "serving %s with %u threads, batches of %zu, %ld us deadline\n", path,
+                engine.threads(), batchSize, latency);
+        Server server(batcher, listener);
+        server.run();
+        fprintf(stderr, "%llu jobs in %llu batches\n", (unsigned long long) batcher.jobs(),
+                (unsigned long long) batcher.batches());
+    }
+    close(listener);
+    unlink(path);
+    return 0;
+}
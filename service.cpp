@@ -0,0 +1,66 @@
+#include "service.hpp"
+
+Batcher::Batcher(Engine &engine, size_t batchSize, chrono::microseconds deadline)
+    : engine(engine), batchSize(max(batchSize, size_t(1))), deadline(deadline),
+      dispatcher(&Batcher::dispatch, this) {
+}
+
+Batcher::~Batcher() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    dispatcher.join();
+}
+
+void Batcher::submit(Rings &rings, Reply reply) {
+    Job job;
+    job.rings.swap(rings);
+    job.reply = move(reply);
+    job.arrival = chrono::steady_clock::now();
+    bool full;
+    {
+        lock_guard<mutex> guard(lock);
+        pending.push_back(move(job));
+        full = pending.size() == 1 || pending.size() >= batchSize;
+    }
+    // the dispatcher only cares about the first job and a full batch
+    if (full) {
+        wake.notify_one();
+    }
+}
+
+void Batcher::dispatch() {
+    vector<Rings> batch;
+    vector<Reply> replies;
+    vector<Decomposition> results;
+    unique_lock<mutex> guard(lock);
+    for (;;) {
+        wake.wait(guard, [&] { return stopping || !pending.empty(); });
+        if (pending.empty()) {
+            return;
+        }
+        // a partial batch waits for company until its oldest job is due
+        wake.wait_until(guard, pending.front().arrival + deadline,
+                        [&] { return stopping || pending.size() >= batchSize; });
+
+        size_t count = min(pending.size(), batchSize);
+        batch.resize(count);
+        replies.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            batch[i].swap(pending.front().rings);
+            replies[i] = move(pending.front().reply);
+            pending.pop_front();
+        }
+        ++batchCount;
+        jobCount += count;
+        guard.unlock();
+
+        engine.decompose(batch, results, Decomposition::Indices);
+        for (size_t i = 0; i < count; ++i) {
+            replies[i](batch[i], results[i]);
+        }
+        guard.lock();
+    }
+}
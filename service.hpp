@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "engine.hpp"
+
+// Coalesces jobs submitted by many connections into batches for the engine.
+// A batch goes out once batchSize jobs are waiting or the oldest job has
+// waited for the deadline, whichever comes first. Replies run on the
+// dispatcher thread in submission order and receive indexed results.
+class Batcher {
+public:
+    typedef function<void(const Rings &input, const Decomposition &result)> Reply;
+
+    Batcher(Engine &engine, size_t batchSize = 256,
+            chrono::microseconds deadline = chrono::microseconds(500));
+    // finishes every submitted job
+    ~Batcher();
+
+    Batcher(const Batcher &) = delete;
+    Batcher &operator=(const Batcher &) = delete;
+
+    // takes the rings over, leaving them empty
+    void submit(Rings &rings, Reply reply);
+
+    uint64_t batches() const { return batchCount; }
+    uint64_t jobs() const { return jobCount; }
+
+private:
+    struct Job {
+        Rings rings;
+        Reply reply;
+        chrono::steady_clock::time_point arrival;
+    };
+
+    Engine &engine;
+    size_t batchSize;
+    chrono::microseconds deadline;
+    deque<Job> pending;
+    mutex lock;
+    condition_variable wake;
+    bool stopping = false;
+    atomic<uint64_t> batchCount{0}, jobCount{0};
+    thread dispatcher;
+
+    void dispatch();
+};
@@ -0,0 +1,104 @@
+#include "shm.hpp"
+
+#include <cerrno>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static const uint32_t skipMarker = 0xffffffff;
+
+static uint64_t recordSize(uint32_t size) {
+    return (sizeof(uint32_t) + size + 7) & ~uint64_t(7);
+}
+
+SharedRing::SharedRing(RingState *state, char *data, uint64_t capacity)
+    : state(state), data(data), capacity(capacity) {
+}
+
+char *SharedRing::reserve(uint32_t size) {
+    if (size > maxRecord()) {
+        return nullptr;
+    }
+    uint64_t head = state->head.position.load(memory_order_relaxed);
+    uint64_t offset = head % capacity, length = recordSize(size);
+    uint64_t skip = offset + length > capacity ? capacity - offset : 0;
+    for (int attempt = 0;; ++attempt) {
+        uint64_t tail = state->tail.position.load();
+        if (capacity - (head - tail) >= skip + length) {
+            break;
+        }
+        if (attempt) {
+            return nullptr;
+        }
+        // announce the wait, then look again in case the consumer just
+        // freed room without seeing the flag
+        state->head.waiting.store(1);
+    }
+    if (skip) {
+        *(uint32_t *) (data + offset) = skipMarker;
+        head += skip;
+        offset = 0;
+    }
+    *(uint32_t *) (data + offset) = size;
+    next = head + length;
+    return data + offset + sizeof(uint32_t);
+}
+
+bool SharedRing::commit() {
+    state->head.position.store(next);
+    return state->tail.waiting.load() && state->tail.waiting.exchange(0);
+}
+
+const char *SharedRing::peek(uint32_t &size) {
+    uint64_t tail = state->tail.position.load(memory_order_relaxed);
+    for (int attempt = 0;; ++attempt) {
+        uint64_t head = state->head.position.load();
+        if (head != tail) {
+            break;
+        }
+        if (attempt) {
+            return nullptr;
+        }
+        state->tail.waiting.store(1);
+    }
+    uint64_t offset = tail % capacity;
+    size = *(const uint32_t *) (data + offset);
+    if (size == skipMarker) {
+        tail += capacity - offset;
+        offset = 0;
+        size = *(const uint32_t *) data;
+    }
+    // the other process may be broken or hostile, stay inside the ring
+    next = tail + recordSize(size);
+    if (corrupt || size > maxRecord() || offset + recordSize(size) > capacity ||
+        next > state->head.position.load()) {
+        corrupt = true;
+        return nullptr;
+    }
+    return data + offset + sizeof(uint32_t);
+}
+
+bool SharedRing::pop() {
+    state->tail.position.store(next);
+    return state->head.waiting.load() && state->head.waiting.exchange(0);
+}
+
+int createSharedMemory(const char *name, size_t size) {
+    int fd = memfd_create(name, MFD_CLOEXEC);
+    if (fd >= 0 && ftruncate(fd, size) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void signalEvent(int fd) {
+    uint64_t one = 1;
+    while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+}
+
+void waitEvent(int fd) {
+    uint64_t count;
+    while (read(fd, &count, sizeof(count)) < 0 && errno == EINTR) {
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "common.hpp"
+
+// Indices of one side of a ring buffer, on its own cache line.
+struct alignas(64) RingIndex {
+    atomic<uint64_t> position;
+    // set by this side before it sleeps, the other side signals it then
+    atomic<uint32_t> waiting;
+};
+
+struct RingState {
+    RingIndex head; // written by the producer
+    RingIndex tail; // written by the consumer
+};
+
+// Start of the shared memory a client hands to the server: a ring of jobs
+// from the client and a ring of results back, ringSize bytes each, follow
+// the header.
+struct SharedRegion {
+    static const uint32_t magic = 0x50444d52; // "RMDP"
+    static const size_t headerSize = 4096;
+
+    uint32_t tag;
+    uint32_t version;
+    uint64_t ringSize;
+    RingState jobs, results;
+
+    static size_t size(uint64_t ringSize) { return headerSize + 2 * ringSize; }
+    char *jobData() { return (char *) this + headerSize; }
+    char *resultData() { return (char *) this + headerSize + ringSize; }
+};
+
+// Single-producer, single-consumer ring of records in shared memory. A
+// record is a 32-bit byte count and the payload, kept contiguous and 8-byte
+// aligned so it can be encoded and decoded in place; a record that would
+// wrap leaves a skip marker and starts over at the beginning.
+//
+// Neither side spins: a producer that finds the ring full (or a consumer
+// that finds it empty) flags itself waiting and sleeps on its own eventfd,
+// and the other side's commit() or pop() says when to signal it.
+class SharedRing {
+public:
+    SharedRing() {}
+    SharedRing(RingState *state, char *data, uint64_t capacity);
+
+    // largest payload that always fits an empty ring, wherever it wraps
+    uint32_t maxRecord() const { return capacity / 2 - sizeof(uint64_t); }
+
+    // Producer: room for size bytes, nullptr while the ring is full.
+    char *reserve(uint32_t size);
+    // publishes the reserved record, true if the consumer waits for a signal
+    bool commit();
+
+    // Consumer: the oldest record, nullptr while the ring is empty.
+    const char *peek(uint32_t &size);
+    // frees the record, true if the producer waits for a signal
+    bool pop();
+    // the producer left records that do not fit the ring
+    bool broken() const { return corrupt; }
+
+private:
+    RingState *state = nullptr;
+    char *data = nullptr;
+    uint64_t capacity = 0;
+    uint64_t next = 0; // head after the pending commit, tail after the pending pop
+    bool corrupt = false;
+};
+
+// Creates an anonymous shared memory file of the given size, -1 on failure.
+int createSharedMemory(const char *name, size_t size);
+
+// Wakes whoever sleeps on the eventfd.
+void signalEvent(int fd);
+// Blocks until the eventfd is signalled.
+void waitEvent(int fd);
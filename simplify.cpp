@@ -0,0 +1,177 @@
+#include "simplify.hpp"
+
+#include <algorithm>
+
+static Scalar sqSegDist(const Point &p, const Point &a, const Point &b) {
+    Scalar dx = b.x - a.x;
+    Scalar dy = b.y - a.y;
+    Scalar len = dx * dx + dy * dy;
+    if (len == 0) {
+        return sqdist(p, a);
+    }
+    Scalar t = ((p.x - a.x) * dx + (p.y - a.y) * dy) / len;
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+    return sqdist(p, Point(a.x + t * dx, a.y + t * dy));
+}
+
+static bool segmentsCross(const Point &p1, const Point &p2, const Point &q1, const Point &q2) {
+    if (min(p1.x, p2.x) > max(q1.x, q2.x) || min(q1.x, q2.x) > max(p1.x, p2.x) ||
+        min(p1.y, p2.y) > max(q1.y, q2.y) || min(q1.y, q2.y) > max(p1.y, p2.y)) {
+        return false;
+    }
+    Scalar d1 = area(p1, p2, q1), d2 = area(p1, p2, q2);
+    Scalar d3 = area(q1, q2, p1), d4 = area(q1, q2, p2);
+    return ((d1 <= 0 && d2 >= 0) || (d1 >= 0 && d2 <= 0)) &&
+           ((d3 <= 0 && d4 >= 0) || (d3 >= 0 && d4 <= 0));
+}
+
+// index of the vertex of ring range (i, j) farthest from segment i-j, or -1
+static int farthest(const Polygon &poly, int i, int j, Scalar &dist) {
+    int n = poly.size(), best = -1;
+    const Point &a = poly[i % n], &b = poly[j % n];
+    dist = -1;
+    for (int k = i + 1; k < j; ++k) {
+        Scalar d = sqSegDist(poly[k % n], a, b);
+        if (d > dist) {
+            dist = d;
+            best = k;
+        }
+    }
+    return best;
+}
+
+// flags every kept segment that crosses a non-adjacent one, in the same ring
+// or another. kept[r] lists the vertices ring r still has; segment a of it
+// runs from kept[r][a] to the next. Segments are swept in order of their
+// left end, so only those whose x ranges overlap are compared.
+static void markCrossings(const Rings &rings, const vector<vector<int>> &kept,
+                          vector<vector<char>> &split) {
+    struct Segment {
+        int ring, a;
+        Point from, to;
+        Scalar left, right;
+    };
+    vector<Segment> segments;
+    for (int r = 0; r < int(rings.size()); ++r) {
+        int m = kept[r].size();
+        for (int a = 0; a < m; ++a) {
+            const Point &from = rings[r][kept[r][a]], &to = rings[r][kept[r][(a + 1) % m]];
+            segments.push_back({r, a, from, to, min(from.x, to.x), max(from.x, to.x)});
+        }
+    }
+    sort(segments.begin(), segments.end(),
+         [](const Segment &p, const Segment &q) { return p.left < q.left; });
+    for (size_t s = 0; s < segments.size(); ++s) {
+        const Segment &p = segments[s];
+        for (size_t t = s + 1; t < segments.size() && segments[t].left <= p.right; ++t) {
+            const Segment &q = segments[t];
+            if (p.ring == q.ring) {
+                int m = kept[p.ring].size(), gap = abs(p.a - q.a);
+                if (gap < 2 || gap == m - 1) {
+                    continue;
+                }
+            }
+            if (segmentsCross(p.from, p.to, q.from, q.to)) {
+                split[p.ring][p.a] = split[q.ring][q.a] = 1;
+            }
+        }
+    }
+}
+
+int cleanPoly(Polygon &poly) {
+    return cleanRing(poly, [](const Point &p) { return p; });
+}
+
+int simplifyPoly(Rings &rings, Scalar tolerance) {
+    if (tolerance <= 0) {
+        return 0;
+    }
+    Scalar sqTolerance = tolerance * tolerance;
+    vector<vector<char>> keep(rings.size());
+    for (size_t r = 0; r < rings.size(); ++r) {
+        const Polygon &poly = rings[r];
+        int n = poly.size();
+        // rings too small to simplify are kept whole
+        keep[r].assign(n, n < 4);
+        if (n < 4) {
+            continue;
+        }
+
+        // anchor the ring at vertex 0 and the vertex farthest from it
+        int far = 1;
+        for (int i = 2; i < n; ++i) {
+            if (sqdist(poly[i], poly[0]) > sqdist(poly[far], poly[0])) {
+                far = i;
+            }
+        }
+        keep[r][0] = keep[r][far] = 1;
+
+        // ranges are walked with unwrapped indices in [0, 2n)
+        vector<pair<int, int>> stack = {{0, far}, {far, n}};
+        while (!stack.empty()) {
+            int i = stack.back().first, j = stack.back().second;
+            stack.pop_back();
+            Scalar d;
+            int k = farthest(poly, i, j, d);
+            if (k >= 0 && d > sqTolerance) {
+                keep[r][k % n] = 1;
+                stack.push_back({i, k});
+                stack.push_back({k, j});
+            }
+        }
+    }
+
+    // refine crossing or degenerate segments until the rings are simple again
+    // and clear of each other
+    for (bool changed = true; changed;) {
+        changed = false;
+        vector<vector<int>> kept(rings.size());
+        vector<vector<char>> split(rings.size());
+        for (size_t r = 0; r < rings.size(); ++r) {
+            for (int i = 0; i < int(rings[r].size()); ++i) {
+                if (keep[r][i]) {
+                    kept[r].push_back(i);
+                }
+            }
+            split[r].assign(kept[r].size(), kept[r].size() < 3);
+        }
+        markCrossings(rings, kept, split);
+        for (size_t r = 0; r < rings.size(); ++r) {
+            int n = rings[r].size(), m = kept[r].size();
+            for (int a = 0; a < m; ++a) {
+                if (!split[r][a]) {
+                    continue;
+                }
+                int i = kept[r][a], j = kept[r][(a + 1) % m];
+                Scalar d;
+                int k = farthest(rings[r], i, j > i ? j : j + n, d);
+                if (k >= 0) {
+                    keep[r][k % n] = 1;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    int removed = 0;
+    for (size_t r = 0; r < rings.size(); ++r) {
+        Polygon &poly = rings[r];
+        int n = poly.size(), out = 0;
+        for (int i = 0; i < n; ++i) {
+            if (keep[r][i]) {
+                poly[out++] = poly[i];
+            }
+        }
+        poly.resize(out);
+        removed += n - out;
+    }
+    return removed;
+}
+
+int simplifyPoly(Polygon &poly, Scalar tolerance) {
+    Rings rings(1);
+    rings[0].swap(poly);
+    int removed = simplifyPoly(rings, tolerance);
+    poly.swap(rings[0]);
+    return removed;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "point.hpp"
+
+// Removes repeated vertices and the middle vertex of every exactly collinear
+// triple, including zero-area spikes, in one linear pass over the ring.
+// Returns the number of vertices removed.
+int cleanPoly(Polygon &poly);
+
+// cleanPoly for rings of vertex handles; vertex(h) returns the Point of h
+template <class T, class Vertex> int cleanRing(vector<T> &ring, Vertex vertex) {
+    auto same = [&](const T &a, const T &b) {
+        Point p = vertex(a), q = vertex(b);
+        return p.x == q.x && p.y == q.y;
+    };
+    auto straight = [&](const T &a, const T &b, const T &c) {
+        return collinear(vertex(a), vertex(b), vertex(c));
+    };
+
+    int n = ring.size(), out = 0;
+    for (int i = 0; i < n; ++i) {
+        const T p = ring[i];
+        if (out > 0 && same(ring[out - 1], p)) {
+            continue;
+        }
+        while (out >= 2 && straight(ring[out - 2], ring[out - 1], p)) {
+            --out;
+        }
+        ring[out++] = p;
+    }
+
+    // the seam between the last and the first vertex
+    int first = 0;
+    while (out - first >= 2 && same(ring[out - 1], ring[first])) {
+        --out;
+    }
+    while (out - first >= 3) {
+        if (straight(ring[out - 2], ring[out - 1], ring[first])) {
+            --out;
+        } else if (straight(ring[out - 1], ring[first], ring[first + 1])) {
+            ++first;
+        } else {
+            break;
+        }
+    }
+    ring.erase(ring.begin() + out, ring.end());
+    ring.erase(ring.begin(), ring.begin() + first);
+    return n - ring.size();
+}
+
+// Douglas-Peucker simplification of a closed ring. Every dropped vertex lies
+// within tolerance of the simplified ring, and segments are refined until the
+// simplified ring has no self-intersections, so a simple input stays simple.
+// Returns the number of vertices removed.
+int simplifyPoly(Polygon &poly, Scalar tolerance);
+
+// simplifyPoly for an outline and its holes, refined until no simplified
+// ring crosses itself or another, so holes stay inside the outline and
+// apart from each other
+int simplifyPoly(Rings &rings, Scalar tolerance);
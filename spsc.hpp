@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+
+#include "common.hpp"
+
+// Bounded lock-free queue between one producing and one consuming thread,
+// such as a decomposition sink on a worker and an uploader draining the
+// pieces. Neither side blocks: push fails while the queue is full and pop
+// while it is empty.
+template <class T> class SpscQueue {
+public:
+    // capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    size_t capacity() const { return slots.size(); }
+
+    bool push(const T &item) {
+        size_t h = head.load(memory_order_relaxed);
+        if (h - tailSeen == slots.size()) {
+            tailSeen = tail.load(memory_order_acquire);
+            if (h - tailSeen == slots.size()) {
+                return false;
+            }
+        }
+        slots[h & mask] = item;
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+    // moves the oldest item out
+    bool pop(T &item) {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t == headSeen) {
+            headSeen = head.load(memory_order_acquire);
+            if (t == headSeen) {
+                return false;
+            }
+        }
+        item = move(slots[t & mask]);
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+private:
+    vector<T> slots;
+    size_t mask;
+    // each side keeps a stale copy of the other's index and only reloads it
+    // when the queue looks full or empty
+    alignas(64) atomic<size_t> head{0};
+    size_t tailSeen = 0;
+    alignas(64) atomic<size_t> tail{0};
+    size_t headSeen = 0;
+};
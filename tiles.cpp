@@ -0,0 +1,118 @@
+#include "tiles.hpp"
+
+#include <algorithm>
+
+#include "cut.hpp"
+#include "merge.hpp"
+
+// tiles smaller than this are not worth their seams
+static const size_t minTileVertices = 256;
+
+// the pieces of ring below each cut, in order, and the rest above the last
+static void cutStrips(const Polygon &ring, int axis, const vector<double> &cuts,
+                      vector<Polygon> &strips) {
+    vector<Polygon> rest(1, ring), below, above;
+    for (double at : cuts) {
+        vector<Polygon> next;
+        for (const Polygon &part : rest) {
+            below.clear();
+            above.clear();
+            cutRing(part.data(), part.size(), axis, at, below, above);
+            strips.insert(strips.end(), below.begin(), below.end());
+            next.insert(next.end(), above.begin(), above.end());
+        }
+        rest.swap(next);
+    }
+    strips.insert(strips.end(), rest.begin(), rest.end());
+}
+
+// Merges pieces across the seams: an edge of one piece whose reverse is an
+// edge of another, both ends on the same cut line, is a stretch of seam the
+// two pieces share.
+static void stitch(vector<Polygon> &pieces, const vector<double> cuts[2]) {
+    vector<Scalar> seams[2];
+    for (int axis = 0; axis < 2; ++axis) {
+        for (double at : cuts[axis]) {
+            seams[axis].push_back(Scalar(at));
+        }
+    }
+    auto onSeam = [&](const Point &a, const Point &b) {
+        return (a.x == b.x && find(seams[0].begin(), seams[0].end(), a.x) != seams[0].end()) ||
+               (a.y == b.y && find(seams[1].begin(), seams[1].end(), a.y) != seams[1].end());
+    };
+    mergeNeighbors(pieces, [](const Point &p) { return p; }, onSeam);
+    pieces.erase(remove_if(pieces.begin(), pieces.end(),
+                           [](const Polygon &piece) { return piece.empty(); }),
+                 pieces.end());
+}
+
+void decomposeTiled(const Polygon &poly, Decomposition &out, Engine &engine,
+                    const TileOptions &options) {
+    if (poly.size() < 3) {
+        return;
+    }
+    Scalar lo[2] = {poly[0].x, poly[0].y}, hi[2] = {lo[0], lo[1]};
+    for (const Point &p : poly) {
+        lo[0] = std::min(lo[0], p.x);
+        hi[0] = max(hi[0], p.x);
+        lo[1] = std::min(lo[1], p.y);
+        hi[1] = max(hi[1], p.y);
+    }
+
+    // a few tiles per thread, square-ish in the polygon's bounding box
+    unsigned grid[2] = {options.columns, options.rows};
+    if (!grid[0] || !grid[1]) {
+        size_t tiles = min(size_t(engine.threads()) * 4, poly.size() / minTileVertices);
+        double aspect = (hi[0] - lo[0] + 1e-9) / (hi[1] - lo[1] + 1e-9);
+        grid[0] = max(1u, unsigned(sqrt(tiles * aspect) + 0.5));
+        grid[1] = max(1u, unsigned(tiles / grid[0]));
+    }
+    vector<double> cuts[2];
+    for (int axis = 0; axis < 2; ++axis) {
+        for (unsigned i = 1; i < grid[axis]; ++i) {
+            Scalar at = lo[axis] + (hi[axis] - lo[axis]) * i / grid[axis];
+            cuts[axis].push_back(cutPosition(at, at));
+        }
+    }
+
+    // columns first, then every column into rows on the pool
+    Polygon ccw = poly;
+    makeCCW(ccw);
+    vector<Polygon> columns;
+    cutStrips(ccw, 0, cuts[0], columns);
+    vector<vector<Polygon>> cells(columns.size());
+    engine.parallelFor(columns.size(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            cutStrips(columns[i], 1, cuts[1], cells[i]);
+        }
+    });
+    vector<Rings> tiles;
+    for (vector<Polygon> &column : cells) {
+        for (Polygon &cell : column) {
+            if (cell.size() >= 3) {
+                tiles.emplace_back(1);
+                tiles.back()[0].swap(cell);
+            }
+        }
+    }
+
+    vector<Decomposition> results;
+    engine.decompose(tiles, results,
+                     Decomposition::Polygons | (out.output & Decomposition::Merged));
+    vector<Polygon> pieces;
+    for (Decomposition &result : results) {
+        pieces.insert(pieces.end(), result.polys.begin(), result.polys.end());
+        out.steinerPoints.insert(out.steinerPoints.end(), result.steinerPoints.begin(),
+                                 result.steinerPoints.end());
+        out.reflexVertices.insert(out.reflexVertices.end(), result.reflexVertices.begin(),
+                                  result.reflexVertices.end());
+        out.truncated |= result.truncated;
+        out.merged += result.merged;
+    }
+    if (options.stitch) {
+        stitch(pieces, cuts);
+    }
+    for (Polygon &piece : pieces) {
+        out.addPolygon(piece);
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "engine.hpp"
+
+struct TileOptions {
+    // grid size, 0 picks one from the thread count and the vertex count
+    unsigned columns = 0, rows = 0;
+    // merge pieces across seams where their union stays convex
+    bool stitch = true;
+};
+
+// Spreads one large polygon over the engine from the start: the outline is
+// clipped to a grid of tiles over its bounding box, the tiles decompose in
+// parallel, and pieces meeting along a seam are merged again where the
+// union stays convex. Fills the polygons of out (indices and adjacency are
+// not produced) with the Steiner points of every tile; the cut vertices on
+// the seams are not reported as Steiner points. With Merged in out.output
+// the pieces of each tile are merged as well.
+void decomposeTiled(const Polygon &poly, Decomposition &out, Engine &engine,
+                    const TileOptions &options = TileOptions());
@@ -0,0 +1,66 @@
+#include "triangulate.hpp"
+#include "simplify.hpp"
+
+template <class N>
+static void appendTriangles(const Polygon &piece, N base, vector<N> &out) {
+    vector<N> local = mapbox::earcut<N, PointLayout>(vector<Polygon>{piece});
+    for (N i : local) {
+        out.push_back(base + i);
+    }
+}
+
+const void *TriangleBatch::indexData() const {
+    return wide ? (const void *) intIndices.data() : (const void *) shortIndices.data();
+}
+
+void TriangleBatch::clear() {
+    vertices.clear();
+    firstVertex.clear();
+    firstIndex.clear();
+    shortIndices.clear();
+    intIndices.clear();
+    wide = false;
+}
+
+void triangulate(const vector<Polygon> &pieces, TriangleBatch &batch) {
+    batch.clear();
+    triangulate(pieces, 0, batch);
+}
+
+void triangulate(const vector<Polygon> &pieces, size_t first, TriangleBatch &batch) {
+    // the end entries go back on after the new pieces
+    if (!batch.firstVertex.empty()) {
+        batch.firstVertex.pop_back();
+        batch.firstIndex.pop_back();
+    }
+
+    size_t total = batch.vertices.size();
+    for (size_t i = first; i < pieces.size(); ++i) {
+        total += pieces[i].size();
+    }
+    if (!batch.wide && total > size_t(numeric_limits<uint16_t>::max()) + 1) {
+        batch.intIndices.assign(batch.shortIndices.begin(), batch.shortIndices.end());
+        batch.shortIndices.clear();
+        batch.wide = true;
+    }
+    // grows geometrically so that appending piece by piece stays linear
+    if (total > batch.vertices.capacity()) {
+        batch.vertices.reserve(max(total, 2 * batch.vertices.capacity()));
+    }
+
+    for (size_t i = first; i < pieces.size(); ++i) {
+        Polygon piece = pieces[i];
+        cleanPoly(piece);
+        uint32_t base = batch.vertices.size();
+        batch.firstVertex.push_back(base);
+        batch.firstIndex.push_back(batch.indexCount());
+        batch.vertices.insert(batch.vertices.end(), piece.begin(), piece.end());
+        if (batch.wide) {
+            appendTriangles<uint32_t>(piece, base, batch.intIndices);
+        } else {
+            appendTriangles<uint16_t>(piece, base, batch.shortIndices);
+        }
+    }
+    batch.firstVertex.push_back(batch.vertices.size());
+    batch.firstIndex.push_back(batch.indexCount());
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+#include <earcut.hpp>
+
+#include "point.hpp"
+
+// earcut reads Point coordinates as Scalar; with IndexedLayout<Scalar> they are
+// stored in the node arrays without any conversion or rounding
+namespace mapbox {
+namespace util {
+template <> struct nth<0, Point> {
+    static Scalar get(const Point &t) { return t.x; };
+};
+
+template <> struct nth<1, Point> {
+    static Scalar get(const Point &t) { return t.y; };
+};
+
+} // namespace util
+} // namespace mapbox
+
+typedef mapbox::IndexedLayout<Scalar> PointLayout;
+
+// Triangles of many pieces packed into one vertex/index buffer pair. Indices
+// are stored as uint16_t whenever every vertex of the batch is addressable
+// with 16 bits, and as uint32_t otherwise.
+class TriangleBatch {
+public:
+    vector<Point> vertices;
+    // per piece ranges, one extra entry at the end
+    vector<uint32_t> firstVertex, firstIndex;
+
+    bool wide = false;
+    vector<uint16_t> shortIndices;
+    vector<uint32_t> intIndices;
+
+    size_t pieces() const { return firstVertex.empty() ? 0 : firstVertex.size() - 1; }
+    size_t indexCount() const { return wide ? intIndices.size() : shortIndices.size(); }
+    size_t indexSize() const { return wide ? sizeof(uint32_t) : sizeof(uint16_t); }
+    const void *indexData() const;
+
+    void clear();
+};
+
+void triangulate(const vector<Polygon> &pieces, TriangleBatch &batch);
+
+// Adds pieces[first..] to a batch that holds the pieces before first, for
+// pieces that arrive a few at a time. The indices already stored are widened
+// once the batch outgrows 16 bits.
+void triangulate(const vector<Polygon> &pieces, size_t first, TriangleBatch &batch);